@@ -6,6 +6,10 @@ bool Action::operator<(const Action& o) const {
     return std::make_tuple(type, x, y) < std::make_tuple(o.type, o.x, o.y);
 }
 
+JointAction::JointAction(int id, const Action& action) {
+    set(id, action);
+}
+
 std::ostream& operator<<(std::ostream& out, const Action& action) {
     return out << (action.type == ActionType::move ? "MOVE" : "BOMB")
                << " " << action.x << " " << action.y;
@@ -2,7 +2,8 @@
 #define ACTION_HPP
 
 #include <iostream>
-#include <map>
+#include <cstdint>
+#include <cassert>
 
 enum class ActionType {
     move = 0,
@@ -20,7 +21,47 @@ struct Action {
                                     const Action& action);
 };
 
-/* player id -> action */
-using Actions = std::map<int, Action>;
+/* action relative to the acting player packed into 4 bits:
+ * index of the direction in GameState::dx/dy times two plus
+ * the bomb flag, GameState::encode/decode convert it */
+using ActionCode = uint8_t;
+/* set of action codes, bit c is set iff code c belongs to it */
+using ActionMask = uint16_t;
+
+/* player id -> action, kept in a fixed array with a mask of
+ * the players that act, so building one never allocates */
+struct JointAction {
+    static constexpr int MAX_PLAYERS = 4;
+
+    JointAction() = default;
+    JointAction(int id, const Action& action);
+
+    inline bool has(int id) const;
+    inline const Action& at(int id) const;
+    inline void set(int id, const Action& action);
+    inline void erase(int id);
+
+    Action actions[MAX_PLAYERS];
+    uint8_t mask = 0;
+};
+
+bool JointAction::has(int id) const {
+    return mask >> id & 1;
+}
+
+const Action& JointAction::at(int id) const {
+    assert(has(id));
+    return actions[id];
+}
+
+void JointAction::set(int id, const Action& action) {
+    assert(0 <= id && id < MAX_PLAYERS);
+    actions[id] = action;
+    mask |= 1 << id;
+}
+
+void JointAction::erase(int id) {
+    mask &= ~(1 << id);
+}
 
 #endif /* ACTION_HPP */
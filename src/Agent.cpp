@@ -7,7 +7,7 @@ void Agent::init(int height, int width, int myid, bool verbose) {
     this->verbose = verbose;
 }
 
-Action Agent::getAction(const GameState& game, const int) {
+Action Agent::getAction(const GameState& game, const Budget&) {
     auto me = game.getPlayer(myid);
     assert(me);
 
@@ -18,3 +18,15 @@ Action Agent::getAction(const GameState& game, const int) {
 
     return action;
 }
+
+void Agent::seed(unsigned seed) {
+    rng.seed(seed);
+    seeded = true;
+}
+
+Action Agent::getSeededAction(const GameState& game, const Budget& budget) {
+    if (!seeded)
+        return getAction(game, budget);
+    Random::Guard guard(rng);
+    return getAction(game, budget);
+}
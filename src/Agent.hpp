@@ -7,14 +7,24 @@
 class Agent {
 public:
     virtual void init(int height, int width, int myid, bool verbose=true);
-    virtual Action getAction(const GameState& game, const int timeLimit);
+    virtual Action getAction(const GameState& game, const Budget& budget);
     virtual ~Agent() = default;
 
+    /* seeded agent draws from its own generator, so that with an
+     * iteration budget its moves replay exactly whatever else runs
+     * in the thread; threads of its own pool are not seeded */
+    void seed(unsigned seed);
+    Action getSeededAction(const GameState& game, const Budget& budget);
+
 public:
     std::string name = "UNKNOWN";
     int height, width;
     int myid;
     bool verbose;
+
+private:
+    std::mt19937 rng;
+    bool seeded = false;
 };
 
 #endif /* AGENT_HPP */
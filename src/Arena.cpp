@@ -1,6 +1,11 @@
 #include "Arena.hpp"
 
-GameState Arena::getGame(const int numPlayers) {
+Arena::Arena(const Budget& budget, const std::optional<unsigned>& seed)
+    : budget(budget), seed(seed) {
+
+}
+
+GameState Arena::getGame(const int numPlayers, Match& match) {
     int gameIdx = Random::rand(TESTS);
     auto game = initialGames[gameIdx];
 
@@ -13,32 +18,31 @@ GameState Arena::getGame(const int numPlayers) {
         game.players.push_back({i,
             positions[perm[i]].first, positions[perm[i]].second,
             1, 3});
+    game.hash = game.computeHash();
 
-    scores.clear();
-    lastAlive.clear();
     for (int i = 0; i < numPlayers; ++i)
-        lastAlive.insert(i);
+        match.lastAlive.insert(i);
 
     return game;
 }
 
-bool Arena::isTerminal(const GameState& game) {
-    return game.players.size() <= 1 || stagnation >= 20;
+bool Arena::isTerminal(const GameState& game, const Match& match) {
+    return game.players.size() <= 1 || match.stagnation >= 20;
 }
 
-std::vector<int> Arena::getWinnersIds(const GameState& game) {
+std::vector<int> Arena::getWinnersIds(const GameState& game, Match& match) {
     switch (int(game.players.size())) {
         case 0: {
-            assert(lastAlive.size() > 1);
+            assert(match.lastAlive.size() > 1);
             std::vector<int> winners;
             int winnerScore = -1;
 
-            for (int id : lastAlive)
-                if (scores[id] > winnerScore) {
-                    winnerScore = scores[id];
+            for (int id : match.lastAlive)
+                if (match.scores[id] > winnerScore) {
+                    winnerScore = match.scores[id];
                     winners = {id};
                 }
-                else if (scores[id] == winnerScore)
+                else if (match.scores[id] == winnerScore)
                     winners.push_back(id);
 
             assert(!winners.empty());
@@ -51,14 +55,21 @@ std::vector<int> Arena::getWinnersIds(const GameState& game) {
             int winnerScore = -1;
 
             for (const auto& player : game.players)
-                if (scores[player.id] > winnerScore) {
-                    winnerScore = scores[player.id];
+                if (match.scores[player.id] > winnerScore) {
+                    winnerScore = match.scores[player.id];
                     winners = {player.id};
                 }
-                else if (scores[player.id] == winnerScore)
+                else if (match.scores[player.id] == winnerScore)
                     winners.push_back(player.id);
 
             assert(!winners.empty());
             return winners;
     }
-}
\ No newline at end of file
+}
+unsigned Arena::getSeed(int gameIdx, int agentIdx) const {
+    assert(seed);
+    std::seed_seq sequence{*seed, unsigned(gameIdx), unsigned(agentIdx)};
+    unsigned value;
+    sequence.generate(&value, &value + 1);
+    return value;
+}
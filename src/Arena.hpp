@@ -4,64 +4,108 @@
 #include "GameState.hpp"
 #include "Action.hpp"
 #include "Common.hpp"
+#include "ThreadPool.hpp"
+#include "MatchStats.hpp"
 
 #include <iostream>
+#include <map>
+#include <set>
 #include <tuple>
 #include <algorithm>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
+#include <mutex>
+#include <atomic>
+#include <optional>
 
 class Arena {
 public:
     template<typename... AgentTs>
     using Agents = std::tuple<AgentTs...>;
 
+    /* with a seed every game and every agent in it get their own
+     * generator, with an iteration budget too, a game replays
+     * exactly however many of them run at once */
+    Arena(const Budget& budget = 30,
+          const std::optional<unsigned>& seed = std::nullopt);
+
+    /* games are played by threads at once, each one
+     * with its own agents, with sprt the match stops at
+     * most times games once the first agent is tested */
     template<typename... AgentTs>
-    void fight(int times) {
+    void fight(int times, int threads = 1,
+               const std::optional<MatchStats::SPRT>& sprt = std::nullopt) {
         init<AgentTs...>();
-
-        for (int i = 0; i < times; ++i) {
-            auto winners = fight<AgentTs...>();
-            for (const auto& winner : winners)
-                stats[winner] += 1.f / winners.size();
-        }
-
-        std::cerr << "\nWinrates:\n" << std::string(25, '-') << std::endl;
-        std::cerr << std::setprecision(1) << std::fixed;
-        for (const auto& [name, points] : stats)
-            std::cerr << name << ": " << points / times * 100 << "%" << std::endl;
+        progress = threads == 1;
+
+        /* results are counted in the order of the games, so that
+         * the verdict does not depend on which thread ends first,
+         * games finished after it are dropped */
+        MatchStats stats(contestants, sprt);
+        std::vector<std::optional<std::vector<std::string>>> results(times);
+        std::atomic<bool> decided(false);
+        std::mutex statsMutex;
+        int counted = 0;
+
+        ThreadPool pool(threads);
+        pool.run(times, [&](int i) {
+            if (decided)
+                return;
+            auto winners = play<AgentTs...>(i);
+
+            std::lock_guard<std::mutex> lock(statsMutex);
+            results[i] = std::move(winners);
+            while (counted < times && results[counted] && !stats.decided())
+                stats.addGame(*results[counted++]);
+            if (stats.decided())
+                decided = true;
+        });
+
+        stats.print(std::cerr);
+        PROFILE_REPORT("the match");
     }
 
+    /* single game, the gameIdx-th of a match, names of its winners */
     template<typename... AgentTs>
-    std::vector<std::string> fight() {
+    std::vector<std::string> play(int gameIdx = 0) {
         constexpr int N = sizeof...(AgentTs);
         static_assert(2 <= N && N <= 4,
             "Provide from 2 to 4 agents!");
 
+        /* agents draw from the generator of the game when built */
+        if (seed)
+            Random::rng.seed(getSeed(gameIdx, N));
         std::tuple<AgentTs...> agents;
         Initer<N, AgentTs...>::init(agents);
+        if (seed)
+            Seeder<N, AgentTs...>::seed(agents, *this, gameIdx);
 
         std::map<int, std::string> agentNames;
         Namer<N, AgentTs...>::name(agents, agentNames);
 
-        auto game = getGame(N);
-        stagnation = 0;
+        Match match;
+        std::ostringstream log;
+        auto game = getGame(N, match);
         int turn;
 
-        for (turn = 0; !isTerminal(game); ++turn) {
+        for (turn = 0; !isTerminal(game, match); ++turn) {
             for (int i = 0; i < N; ++i)
                 if (std::find_if(all(game.players), [i](const Player& player){
                         return player.id == i; }) == game.players.end())
-                    lastAlive.erase(i);
+                    match.lastAlive.erase(i);
 
-            Actions agentActions;
-            Advancer<N, AgentTs...>::advance(agents, game, agentActions);
+            JointAction agentActions;
+            Advancer<N, AgentTs...>::advance(agents, game, budget, agentActions);
 
             std::set<int> invalids;
-            for (const auto& [id, action] : agentActions)
-                if (!game.validActions({{id, action}})) {
-                    std::cerr << "Invalid action " << id << " " << action << std::endl;
-                    invalids.insert(id);
+            for (int id = 0; id < N; ++id)
+                if (agentActions.has(id)) {
+                    const auto& action = agentActions.at(id);
+                    if (!game.validActions(JointAction(id, action))) {
+                        log << "Invalid action " << id << " " << action << std::endl;
+                        invalids.insert(id);
+                    }
                 }
             for (const auto& id : invalids)
                 agentActions.erase(id);
@@ -69,10 +113,11 @@ public:
             game.myid = -1;
             auto succInfo = game.succ(game.getExplosions(), agentActions);
             // if (!succInfo)
-            //     for (const auto& [id, action] : agentActions) {
-            //         debug(game.validActions({{id, action}}));
-            //         debug(id, action);
-            //     }
+            //     for (int id = 0; id < N; ++id)
+            //         if (agentActions.has(id)) {
+            //             debug(game.validActions(JointAction(id, agentActions.at(id))));
+            //             debug(id, agentActions.at(id));
+            //         }
             assert(succInfo); // if not probably invalid action - get rid of that
             auto& [nextGame, extra] = succInfo.value();
 
@@ -80,54 +125,60 @@ public:
                 for (int i = 0; i < int(nextGame.players.size()); ++i) {
                     const auto& player = nextGame.players[i];
                     if (player.id == id) {
-                        std::swap(game.players[i], game.players.back());
+                        std::swap(nextGame.players[i], nextGame.players.back());
                         nextGame.players.pop_back();
-                        std::cerr << "Kicked out " << i << std::endl;
+                        nextGame.hash = nextGame.computeHash();
+                        log << "Kicked out " << i << std::endl;
                         break;
                     }
                 }
             }
 
-            ++stagnation;
+            ++match.stagnation;
 
             for (int i = 0; i < N; ++i)
                 if (extra.boxesDestroyed[i]) {
-                    stagnation = 0;
-                    scores[i] += extra.boxesDestroyed[i];
+                    match.stagnation = 0;
+                    match.scores[i] += extra.boxesDestroyed[i];
                 }
 
             game = nextGame;
 
-            std::cerr << "Done " << turn << " turns\r";
+            if (progress)
+                std::cerr << "Done " << turn << " turns\r";
         }
 
-        std::cerr << "\rTotal number of turns: " << turn << std::endl;
+        log << "\rTotal number of turns: " << turn << std::endl;
 
-        std::cerr << "Winners: ";
+        log << "Winners: ";
         bool first = true;
         std::vector<std::string> winners;
-        auto winnerIds = getWinnersIds(game);
+        auto winnerIds = getWinnersIds(game, match);
 
         for (const auto& winnerId : winnerIds) {
             if (!first)
-                std::cerr << ", ";
+                log << ", ";
             else
                 first = false;
             assert(agentNames.count(winnerId));
             std::string winnerName = agentNames[winnerId] +
                 "-" + std::to_string(winnerId);
-            std::cerr << winnerName;
+            log << winnerName;
             winners.push_back(winnerName);
         }
-        std::cerr << std::endl;
+        log << std::endl;
 
-        std::cerr << "Boxes destroyed:" << std::endl;
-        for (const auto& [id, boxes] : scores) {
+        log << "Boxes destroyed:" << std::endl;
+        for (const auto& [id, boxes] : match.scores) {
             std::string winnerName = agentNames[id] +
                 "-" + std::to_string(id);
-            std::cerr << winnerName << ": " << scores[id] << std::endl;
+            log << winnerName << ": " << boxes << std::endl;
         }
-        std::cerr << std::endl;
+        log << std::endl;
+
+        /* reports of the games do not interleave */
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << log.str();
 
         return winners;
     }
@@ -147,6 +198,21 @@ private:
         static void init(Agents<AgentTs...>&) {}
     };
 
+    template<int i, typename... AgentTs>
+    struct Seeder {
+        static void seed(Agents<AgentTs...>& agents,
+                         const Arena& arena, int gameIdx) {
+            auto& agent = std::get<i - 1>(agents);
+            agent.seed(arena.getSeed(gameIdx, i - 1));
+            Seeder<i - 1, AgentTs...>::seed(agents, arena, gameIdx);
+        }
+    };
+
+    template<typename... AgentTs>
+    struct Seeder<0, AgentTs...> {
+        static void seed(Agents<AgentTs...>&, const Arena&, int) {}
+    };
+
     template<int i, typename... AgentTs>
     struct Namer {
         static void name(const Agents<AgentTs...>& agents,
@@ -180,56 +246,63 @@ private:
 
     template<int i, typename... AgentTs>
     struct Advancer {
-        static void advance(Agents<AgentTs...>& agents,
-                            GameState& game, Actions& agentActions) {
+        static void advance(Agents<AgentTs...>& agents, GameState& game,
+                            const Budget& budget, JointAction& agentActions) {
             auto& agent = std::get<i - 1>(agents);
             if (game.getPlayer(agent.myid)) {
                 game.myid = i - 1;
-                auto action = agent.getAction(game, timeLimit);
-                assert(!agentActions.count(agent.myid));
-                agentActions[agent.myid] = action;
+                auto action = agent.getSeededAction(game, budget);
+                assert(!agentActions.has(agent.myid));
+                agentActions.set(agent.myid, action);
             }
-            Advancer<i - 1, AgentTs...>::advance(agents, game, agentActions);
+            Advancer<i - 1, AgentTs...>::advance(agents, game, budget, agentActions);
         }
     };
 
     template<typename... AgentTs>
     struct Advancer<0, AgentTs...> {
-        static void advance(Agents<AgentTs...>&,
-                            GameState&, Actions&) {}
+        static void advance(Agents<AgentTs...>&, GameState&,
+                            const Budget&, JointAction&) {}
     };
 
     template<typename... AgentTs>
     void init() {
-        stats.clear();
-
         constexpr int N = sizeof...(AgentTs);
         std::tuple<AgentTs...> agents;
         Initer<N, AgentTs...>::init(agents);
 
-        std::map<int, std::string> agentNames;
-        Namer<N, AgentTs...>::name(agents, agentNames);
-        assert(agentNames.size() == N);
+        std::map<int, std::string> names;
+        Namer<N, AgentTs...>::name(agents, names);
+        assert(names.size() == N);
 
-        for (const auto& [id, name] : agentNames) {
-            auto nameWithId = name + "-" + std::to_string(id);
-            stats[nameWithId] = 0;
-        }
+        contestants.clear();
+        for (const auto& [id, name] : names)
+            contestants.push_back(name + "-" + std::to_string(id));
 
         for (int i = 0; i < TESTS; ++i) {
             std::string filename = "./tests/testcase" + std::to_string(i + 1) + ".txt";
             std::ifstream file(filename);
             assert(file.is_open());
+            int width, height, id;
+            file >> width >> height >> id;
             file >> initialGames[i];
         }
     }
 
-    GameState getGame(const int numPlayers);
-    bool isTerminal(const GameState& game);
-    std::vector<int> getWinnersIds(const GameState& game);
+    /* everything about a game being played besides its state */
+    struct Match {
+        std::map<int, int> scores;
+        std::set<int> lastAlive;
+        int stagnation = 0;
+    };
+
+    GameState getGame(const int numPlayers, Match& match);
+    bool isTerminal(const GameState& game, const Match& match);
+    std::vector<int> getWinnersIds(const GameState& game, Match& match);
+    /* seed of an agent of the game, the game itself is the last one */
+    unsigned getSeed(int gameIdx, int agentIdx) const;
 
 private:
-    static constexpr int timeLimit = 30;
     static constexpr std::pair<int, int> positions[] = {
         {0, 0},
         {GameState::W - 1, GameState::H - 1},
@@ -238,11 +311,14 @@ private:
     };
     static constexpr int TESTS = 2;
 
-    std::map<std::string, float> stats;
+    Budget budget;
+    std::optional<unsigned> seed;
+    /* in the order of ids, the first one is tested */
+    std::vector<std::string> contestants;
     GameState initialGames[TESTS];
-    std::map<int, int> scores;
-    std::set<int> lastAlive;
-    int stagnation = 0;
+    /* turn by turn progress, only when games are played one by one */
+    bool progress = true;
+    std::mutex logMutex;
 };
 
 #endif /* ARENA_HPP */
\ No newline at end of file
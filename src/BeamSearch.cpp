@@ -4,28 +4,28 @@
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 
-int BeamSearch::totalBeamLengthSum = 0;
+std::atomic<int> BeamSearch::totalBeamLengthSum(0);
 
-BeamSearch::BeamSearch() {
+BeamSearch::BeamSearch(int threads) :
+    threadPool(new ThreadPool(threads)), beam(BEAM_WIDTH) {
     name = "BeamSearch";
+    candidates.reserve(GameState::H * GameState::W * LOCAL_BEAM_WIDTH);
 }
 
-Action BeamSearch::getAction(const GameState& game, const int timeLimit) {
-    Timer timer(timeLimit);
+Action BeamSearch::getAction(const GameState& game, const Budget& budget) {
+    BENCH();
+    Timer timer(budget);
 
     State::evalFunction = eval;
+    table.newTurn();
 
-    auto possibleActions = game.getPossibleActions();
     auto me = game.getPlayer(myid);
     assert(me);
+    ActionMask possibleActions = game.getSafeActions();
     Action action = {ActionType::move, me->x, me->y};
 
-    static constexpr int BEAM_SIZE = GameState::H * GameState::W * LOCAL_BEAM_WIDTH;
-    static constexpr int MAX_BEAM_SIZE =  BEAM_SIZE < BEAM_WIDTH ? BEAM_WIDTH : BEAM_SIZE;
-
-    static std::array<State, MAX_BEAM_SIZE> beam;
-    std::vector<State> localBeams[game.H][game.W];
     beam[0] = State::getInitialState(game);
     int currentBeam = 1;
 
@@ -37,82 +37,79 @@ Action BeamSearch::getAction(const GameState& game, const int timeLimit) {
     int depth = 0;
 
     // for (depth = 0; depth < BEAM_DEPTH; ++depth) {
-    for (depth = 0; timer.isTimeLeft(); ++depth) {
-        std::set<hash_t> visited;
-
-        for (int k = 0; k < currentBeam; ++k) {
-            const auto& state = beam[k];
-
-            for (int i = 0; i < game.DIR_COUNT; ++i)
-                for (const auto& actionType : game.actionTypes) {
-                    auto currentMe = state.game.getPlayer(myid);
-                    assert(currentMe && currentMe->id == myid);
-                    Action currentAction = { actionType,
-                        currentMe->x + game.dx[i],currentMe->y + game.dy[i]};
-
-                    if (depth == 0 && !possibleActions.count(currentAction))
-                        continue;
-
-                    auto next = state.succ({{myid, currentAction}});
-                    if (!next) {
-                        ++notNextReason;
-                        continue;
-                    }
-
-                    const auto& nextState = next.value();
-                    if (visited.count(nextState.hash)) {
-                        ++visitedReason;
-                        continue;
-                    }
-                    visited.insert(nextState.hash);
-
-                    if (!nextState.game.canSurvive(nextState.explosions)) {
-                        ++survivalReason;
-                        continue;
-                    }
-
-                    auto nextMe = nextState.game.getPlayer(myid);
-                    assert(nextMe && nextMe->id == myid);
-                    localBeams[nextMe->y][nextMe->x].push_back(nextState);
-                }
-
-            if (!timer.isTimeLeft())
-                break;
-        }
-
-        if (!timer.isTimeLeft())
+    /* with an iteration budget a layer is done only if
+     * expansions of all its states fit in the budget */
+    for (depth = 0; timer.spend(currentBeam); ++depth) {
+        int chunks = (currentBeam + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        if (int(expansions.size()) < chunks)
+            expansions.resize(chunks);
+
+        ActionMask allowed = depth == 0 ? possibleActions : ActionMask(~0);
+        std::atomic<bool> timeout(false);
+        threadPool->run(chunks, [&](int c) {
+            State::evalFunction = eval;
+            GameState::myid = myid;
+            int from = c * CHUNK_SIZE;
+            int to = std::min(currentBeam, from + CHUNK_SIZE);
+            if (!expand(expansions[c], from, to, allowed, timer))
+                timeout = true;
+        });
+
+        if (timeout || !timer.isTimeLeft())
             break;
 
-        assert(currentBeam <= MAX_BEAM_SIZE);
-
-        currentBeam = 0;
-        for (int y = 0; y < height; ++y)
-            for (int x = 0; x < width; ++x) {
-                int localBeamLength = localBeams[y][x].size();
-                int beamToSort = std::min(localBeamLength, LOCAL_BEAM_WIDTH);
-                std::partial_sort(localBeams[y][x].data(),
-                    localBeams[y][x].data() + beamToSort,
-                    localBeams[y][x].data() + localBeamLength,
-                    std::greater<State>());
-
-                std::move(localBeams[y][x].data(),
-                    localBeams[y][x].data() + beamToSort,
-                    beam.data() + currentBeam);
-                currentBeam += beamToSort;
-                localBeams[y][x].clear();
-            }
-
-        totalBeamLength += currentBeam;
+        /* the first of equal states in the serial order is kept */
+        int duplicates[SHARDS];
+        threadPool->run(SHARDS, [&](int s) {
+            duplicates[s] = dedup(s, chunks);
+        });
+        threadPool->run(chunks, [&](int c) {
+            GameState::myid = myid;
+            filter(expansions[c]);
+        });
+
+        for (int c = 0; c < chunks; ++c) {
+            const Expansion& expansion = expansions[c];
+            notNextReason += expansion.notNext;
+            survivalReason += expansion.survival;
+            for (int i = 0; i < int(expansion.states.size()); ++i)
+                if (expansion.cells[i] != DROPPED) {
+                    const State& state = expansion.states[i];
+                    localBeams[expansion.cells[i]].push({state.score, &state});
+                }
+        }
+        for (int s = 0; s < SHARDS; ++s)
+            visitedReason += duplicates[s];
+
+        /* states stay where they were generated, only the scored pointers
+         * are sorted and just the chosen states are copied into the beam */
+        candidates.clear();
+        for (auto& localBeam : localBeams) {
+            candidates.insert(candidates.end(), localBeam.heap, localBeam.heap + localBeam.size);
+            localBeam.size = 0;
+        }
+        totalBeamLength += candidates.size();
 
-        int beamToSort = std::min(currentBeam, BEAM_WIDTH);
-        std::partial_sort(beam.data(),
-            beam.data() + beamToSort,
-            beam.data() + currentBeam,
-            std::greater<State>());
+        int beamToSort = std::min(int(candidates.size()), BEAM_WIDTH);
+        std::partial_sort(candidates.begin(),
+            candidates.begin() + beamToSort, candidates.end(), better);
+        for (int k = 0; k < beamToSort; ++k)
+            beam[k] = *candidates[k].state;
         currentBeam = beamToSort;
 
-        if (currentBeam > 0)
-            action = beam[0].firstAction;
+        /* only the states kept in the beam are marked, a pruned one
+         * may still come back through another line; the table is just
+         * a visited set of the turn here, so nothing else is stored */
+        TranspositionTable::Entry entry;
+        entry.depth = depth + 1;
+        entry.visits = 1;
+        for (int k = 0; k < currentBeam; ++k)
+            table.store(beam[k].hash, entry);
+
+        /* nothing survives, searching on would only burn the budget */
+        if (currentBeam == 0)
+            break;
+        action = game.decode(beam[0].firstAction, me->x, me->y);
     }
 
     totalBeamLengthSum += totalBeamLength;
@@ -122,7 +119,7 @@ Action BeamSearch::getAction(const GameState& game, const int timeLimit) {
         std::cerr << "notNextReason: " << notNextReason << std::endl;
         std::cerr << "visitedReason: " << visitedReason << std::endl;
         std::cerr << "survivalReason: " << survivalReason << std::endl;
-        std::cerr << "totalBeamLengthSum: " << totalBeamLengthSum << std::endl;
+        std::cerr << "totalBeamLengthSum: " << totalBeamLengthSum.load() << std::endl;
         std::cerr << "beam depth: " << depth << std::endl;
 
         if (!timer.isTimeLeft())
@@ -134,6 +131,85 @@ Action BeamSearch::getAction(const GameState& game, const int timeLimit) {
     return action;
 }
 
+/* successors of beam[from, to), false if the time ran out */
+bool BeamSearch::expand(Expansion& expansion, int from, int to,
+                        ActionMask allowed, const Timer& timer) {
+    expansion.states.clear();
+    for (auto& shard : expansion.shards)
+        shard.clear();
+    expansion.notNext = 0;
+
+    for (int k = from; k < to; ++k) {
+        const auto& state = beam[k];
+
+        auto currentMe = state.game.getPlayer(myid);
+        assert(currentMe && currentMe->id == myid);
+        ActionMask actions = state.game.getActionMask(myid) & allowed;
+
+        for (; actions; actions &= actions - 1) {
+            Action currentAction = GameState::decode(__builtin_ctz(actions),
+                currentMe->x, currentMe->y);
+
+            auto next = state.succ(JointAction(myid, currentAction));
+            if (!next) {
+                ++expansion.notNext;
+                continue;
+            }
+
+            expansion.shards[next->hash % SHARDS].push_back(expansion.states.size());
+            expansion.states.push_back(next.value());
+        }
+
+        if (!timer.isTimeLeft())
+            return false;
+    }
+
+    expansion.cells.assign(expansion.states.size(), 0);
+    return true;
+}
+
+/* marks repeated states of the shard as dropped, returns their number,
+ * the table is only read here, it gets the beam after the layer */
+int BeamSearch::dedup(int shard, int chunks) {
+    auto& seen = visited[shard];
+    seen.clear();
+
+    int duplicates = 0;
+    TranspositionTable::Entry entry;
+    for (int c = 0; c < chunks; ++c) {
+        Expansion& expansion = expansions[c];
+        for (int i : expansion.shards[shard]) {
+            hash_t hash = expansion.states[i].hash;
+            if (!seen.insert(hash).second ||
+                (table.probe(hash, entry) && entry.current)) {
+                expansion.cells[i] = DROPPED;
+                ++duplicates;
+            }
+        }
+    }
+    return duplicates;
+}
+
+/* drops states the player cannot survive, the others get their cell */
+void BeamSearch::filter(Expansion& expansion) {
+    expansion.survival = 0;
+    for (int i = 0; i < int(expansion.states.size()); ++i) {
+        if (expansion.cells[i] == DROPPED)
+            continue;
+
+        const State& nextState = expansion.states[i];
+        if (!nextState.game.canSurvive(nextState.explosions)) {
+            expansion.cells[i] = DROPPED;
+            ++expansion.survival;
+            continue;
+        }
+
+        auto nextMe = nextState.game.getPlayer(myid);
+        assert(nextMe && nextMe->id == myid);
+        expansion.cells[i] = nextMe->y * width + nextMe->x;
+    }
+}
+
 BeamSearch::eval_t BeamSearch::eval(const State& s) {
     eval_t points = 0.0;
 
@@ -148,16 +224,9 @@ BeamSearch::eval_t BeamSearch::eval(const State& s) {
     points += 3.2 * std::min(s.myBombs, 3) + 1.9 * s.myBombs;
     points += 0.2 * (s.myBombs - me->bombs);
 
-    for (int y = 0; y < s.game.H; ++y)
-        for (int x = 0; x < s.game.W; ++x)
-            if (s.game.board.isBox(x, y) && s.explosions.isOwner(x, y, s.game.myid))
-                points += 1 * (boxReward - s.explosions.e[y][x].time);
-            
-    eval_t sumDists = 0;
-    for (int y = 0; y < s.game.H; ++y)
-        for (int x = 0; x < s.game.W; ++x)
-            if (s.game.board.isBox(x, y))
-                sumDists += std::abs(me->x - x) + std::abs(me->y - y);
+    points += s.explosions.ownedReward(s.game.board.boxes, s.game.myid, boxReward);
+
+    eval_t sumDists = s.game.board.boxes.distanceSum(me->x, me->y);
     points -= 0.1 * sumDists;
     
     points -= 0.04 * std::abs(me->y - s.game.H * 0.5);
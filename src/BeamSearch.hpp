@@ -6,15 +6,23 @@
 #include "GameState.hpp"
 #include "Common.hpp"
 #include "State.hpp"
+#include "ThreadPool.hpp"
+#include "TranspositionTable.hpp"
+
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
 
 class BeamSearch : public Agent {
 public:
     using eval_t = State::eval_t;
 
-    BeamSearch();
+    explicit BeamSearch(int threads = 1);
 
     Action getAction(const GameState& game,
-                     const int timeLimit) override;
+                     const Budget& budget) override;
 
     static eval_t eval(const State& state);
 
@@ -23,7 +31,76 @@ private:
     static constexpr int LOCAL_BEAM_WIDTH = 20;
     static constexpr int BEAM_DEPTH = 15;
 
-    static int totalBeamLengthSum;
+    /* states expanded by a single task and shards of the visited set,
+     * both are fixed, so that the result does not depend on the number
+     * of threads and is the same as of the serial search */
+    static constexpr int CHUNK_SIZE = 8;
+    static constexpr int SHARDS = 16;
+    static constexpr int DROPPED = -1;
+
+    /* successors of a chunk of the beam, in the order of generation */
+    struct Expansion {
+        std::vector<State> states;
+        /* cell of the player in the state or DROPPED */
+        std::vector<int> cells;
+        /* indices of the states, split by the shard of their hash */
+        std::vector<int> shards[SHARDS];
+        int notNext = 0;
+        int survival = 0;
+    };
+
+    /* state of an expansion with its score next to it,
+     * sorting these does not touch the states */
+    struct Candidate {
+        eval_t score;
+        const State* state;
+    };
+
+    static inline bool better(const Candidate& a, const Candidate& b);
+
+    /* best LOCAL_BEAM_WIDTH candidates of a cell, kept while they are
+     * generated in a heap with the worst one on top */
+    struct LocalBeam {
+        Candidate heap[LOCAL_BEAM_WIDTH];
+        int size = 0;
+
+        inline void push(const Candidate& candidate);
+    };
+
+    bool expand(Expansion& expansion, int from, int to,
+                ActionMask allowed, const Timer& timer);
+    int dedup(int shard, int chunks);
+    void filter(Expansion& expansion);
+
+    static std::atomic<int> totalBeamLengthSum;
+
+    std::unique_ptr<ThreadPool> threadPool;
+    std::vector<State> beam;
+    std::vector<Expansion> expansions;
+    std::unordered_set<hash_t> visited[SHARDS];
+    /* states kept in the beam in this turn, reaching one again
+     * in a later layer is a repetition, it is dropped; only
+     * presence is used, evaluations are not stored */
+    TranspositionTable table;
+    /* best successors per cell of the board */
+    LocalBeam localBeams[GameState::H * GameState::W];
+    std::vector<Candidate> candidates;
 };
+
+bool BeamSearch::better(const Candidate& a, const Candidate& b) {
+    return a.score > b.score;
+}
+
+void BeamSearch::LocalBeam::push(const Candidate& candidate) {
+    if (size < LOCAL_BEAM_WIDTH) {
+        heap[size++] = candidate;
+        std::push_heap(heap, heap + size, better);
+    }
+    else if (better(candidate, heap[0])) {
+        std::pop_heap(heap, heap + size, better);
+        heap[size - 1] = candidate;
+        std::push_heap(heap, heap + size, better);
+    }
+}
     
 #endif /* BEAMSEARCH_HPP */
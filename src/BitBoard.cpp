@@ -0,0 +1,62 @@
+#include "BitBoard.hpp"
+
+#include <array>
+#include <cstdlib>
+
+namespace {
+    BitBoard makeFull() {
+        BitBoard mask;
+        for (int y = 0; y < BitBoard::H; ++y)
+            for (int x = 0; x < BitBoard::W; ++x)
+                mask.set(x, y);
+        return mask;
+    }
+
+    std::array<BitBoard, BitBoard::W> makeColumns() {
+        std::array<BitBoard, BitBoard::W> columns;
+        for (int x = 0; x < BitBoard::W; ++x)
+            for (int y = 0; y < BitBoard::H; ++y)
+                columns[x].set(x, y);
+        return columns;
+    }
+
+    std::array<BitBoard, BitBoard::H> makeRows() {
+        std::array<BitBoard, BitBoard::H> rows;
+        for (int y = 0; y < BitBoard::H; ++y)
+            for (int x = 0; x < BitBoard::W; ++x)
+                rows[y].set(x, y);
+        return rows;
+    }
+
+    const BitBoard fullMask = makeFull();
+    const std::array<BitBoard, BitBoard::W> columnMasks = makeColumns();
+    const std::array<BitBoard, BitBoard::H> rowMasks = makeRows();
+}
+
+bool BitBoard::operator==(const BitBoard& o) const {
+    for (int i = 0; i < WORDS; ++i)
+        if (w[i] != o.w[i])
+            return false;
+    return true;
+}
+
+int BitBoard::distanceSum(int x, int y) const {
+    int sum = 0;
+    for (int cx = 0; cx < W; ++cx)
+        sum += std::abs(x - cx) * (*this & column(cx)).count();
+    for (int cy = 0; cy < H; ++cy)
+        sum += std::abs(y - cy) * (*this & row(cy)).count();
+    return sum;
+}
+
+const BitBoard& BitBoard::full() {
+    return fullMask;
+}
+
+const BitBoard& BitBoard::column(int x) {
+    return columnMasks[x];
+}
+
+const BitBoard& BitBoard::row(int y) {
+    return rowMasks[y];
+}
@@ -0,0 +1,165 @@
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include <cstdint>
+#include <cassert>
+
+/* set of cells of the 11x13 board, cell (x, y) is bit y * W + x,
+ * 143 cells fit into three 64-bit words, the fourth one is always
+ * zero and only pads the board to a single 256-bit lane, so that
+ * bitwise operations vectorize */
+struct BitBoard {
+    static constexpr int H = 11;
+    static constexpr int W = 13;
+    static constexpr int CELLS = H * W;
+    static constexpr int WORDS = 4;
+
+    uint64_t w[WORDS] = {}; /* zero initialization */
+
+    inline bool get(int x, int y) const;
+    inline void set(int x, int y);
+    inline void reset(int x, int y);
+
+    inline bool any() const;
+    inline int count() const;
+
+    inline BitBoard operator&(const BitBoard& o) const;
+    inline BitBoard operator|(const BitBoard& o) const;
+    inline BitBoard operator^(const BitBoard& o) const;
+    inline BitBoard operator~() const;
+    inline BitBoard& operator&=(const BitBoard& o);
+    inline BitBoard& operator|=(const BitBoard& o);
+    inline BitBoard andNot(const BitBoard& o) const;
+    inline BitBoard operator<<(int n) const;
+    inline BitBoard operator>>(int n) const;
+    bool operator==(const BitBoard& o) const;
+
+    /* cells that share a side with a cell of the set */
+    inline BitBoard neighbours() const;
+
+    /* call f(x, y) for every cell of the set */
+    template<typename F>
+    void forEach(F f) const;
+
+    /* sum of manhattan distances from (x, y) to all the cells */
+    int distanceSum(int x, int y) const;
+
+    /* masks of all board cells, of a single column and of a single row */
+    static const BitBoard& full();
+    static const BitBoard& column(int x);
+    static const BitBoard& row(int y);
+
+    static inline int index(int x, int y);
+};
+
+int BitBoard::index(int x, int y) {
+    return y * W + x;
+}
+
+bool BitBoard::get(int x, int y) const {
+    int i = index(x, y);
+    return w[i >> 6] >> (i & 63) & 1;
+}
+
+void BitBoard::set(int x, int y) {
+    int i = index(x, y);
+    w[i >> 6] |= uint64_t(1) << (i & 63);
+}
+
+void BitBoard::reset(int x, int y) {
+    int i = index(x, y);
+    w[i >> 6] &= ~(uint64_t(1) << (i & 63));
+}
+
+bool BitBoard::any() const {
+    return (w[0] | w[1] | w[2] | w[3]) != 0;
+}
+
+int BitBoard::count() const {
+    return __builtin_popcountll(w[0]) + __builtin_popcountll(w[1]) +
+        __builtin_popcountll(w[2]) + __builtin_popcountll(w[3]);
+}
+
+BitBoard BitBoard::operator&(const BitBoard& o) const {
+    BitBoard r;
+    for (int i = 0; i < WORDS; ++i)
+        r.w[i] = w[i] & o.w[i];
+    return r;
+}
+
+BitBoard BitBoard::operator|(const BitBoard& o) const {
+    BitBoard r;
+    for (int i = 0; i < WORDS; ++i)
+        r.w[i] = w[i] | o.w[i];
+    return r;
+}
+
+BitBoard BitBoard::operator^(const BitBoard& o) const {
+    BitBoard r;
+    for (int i = 0; i < WORDS; ++i)
+        r.w[i] = w[i] ^ o.w[i];
+    return r;
+}
+
+/* complement within the board, bits past the last cell stay zero */
+BitBoard BitBoard::operator~() const {
+    return full().andNot(*this);
+}
+
+BitBoard& BitBoard::operator&=(const BitBoard& o) {
+    for (int i = 0; i < WORDS; ++i)
+        w[i] &= o.w[i];
+    return *this;
+}
+
+BitBoard& BitBoard::operator|=(const BitBoard& o) {
+    for (int i = 0; i < WORDS; ++i)
+        w[i] |= o.w[i];
+    return *this;
+}
+
+BitBoard BitBoard::andNot(const BitBoard& o) const {
+    BitBoard r;
+    for (int i = 0; i < WORDS; ++i)
+        r.w[i] = w[i] & ~o.w[i];
+    return r;
+}
+
+/* shifts by 0 < n < 64 cells towards higher indices,
+ * cells pushed past the last one are dropped */
+BitBoard BitBoard::operator<<(int n) const {
+    assert(0 < n && n < 64);
+    BitBoard r;
+    r.w[0] = w[0] << n;
+    for (int i = 1; i < WORDS; ++i)
+        r.w[i] = w[i] << n | w[i - 1] >> (64 - n);
+    return r & full();
+}
+
+/* shifts by 0 < n < 64 cells towards lower indices */
+BitBoard BitBoard::operator>>(int n) const {
+    assert(0 < n && n < 64);
+    BitBoard r;
+    for (int i = 0; i < WORDS - 1; ++i)
+        r.w[i] = w[i] >> n | w[i + 1] << (64 - n);
+    r.w[WORDS - 1] = w[WORDS - 1] >> n;
+    return r;
+}
+
+/* horizontal shifts wrap around rows, so the wrapped column is cut off */
+BitBoard BitBoard::neighbours() const {
+    BitBoard west = (*this >> 1).andNot(column(W - 1));
+    BitBoard east = (*this << 1).andNot(column(0));
+    return west | east | (*this >> W) | (*this << W);
+}
+
+template<typename F>
+void BitBoard::forEach(F f) const {
+    for (int i = 0; i < WORDS; ++i)
+        for (uint64_t bits = w[i]; bits; bits &= bits - 1) {
+            int cell = i * 64 + __builtin_ctzll(bits);
+            f(cell % W, cell / W);
+        }
+}
+
+#endif /* BITBOARD_HPP */
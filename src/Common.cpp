@@ -2,6 +2,14 @@
 
 #include <cassert>
 
+#ifdef PROFILE
+#include <mutex>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#endif
+
 Point point(int x, int y) {
     return { x, y };
 }
@@ -20,18 +28,41 @@ bool operator<(const Point& a, const Point& b) {
     return a.x < b.x;
 }
 
+Budget::Budget(int timeLimit) : type(Type::time), limit(timeLimit) {
+
+}
+
+Budget Budget::iterations(int count) {
+    Budget budget(count);
+    budget.type = Type::iterations;
+    return budget;
+}
+
 Timer::Timer(time_t timeLimit) : timeLimit(timeLimit), start(clock_t::now()) {
 
 }
 
+Timer::Timer(const Budget& budget) : type(budget.type),
+    timeLimit(budget.limit), iterations(budget.limit), start(clock_t::now()) {
+
+}
+
 void Timer::set(float timeLimit) {
     this->timeLimit = timeLimit;
 }
 
 bool Timer::isTimeLeft() const {
+    if (type == Budget::Type::iterations)
+        return true;
     return getTimePassed() <= timeLimit - margin;
 }
 
+bool Timer::spend(int count) const {
+    if (type == Budget::Type::time)
+        return isTimeLeft();
+    return spent.fetch_add(count, std::memory_order_relaxed) + count <= iterations;
+}
+
 void Timer::reset() {
     start = clock_t::now();
 }
@@ -45,27 +76,115 @@ Timer::time_t Timer::getTimeLeft() const {
     return timeLimit - getTimePassed();
 }
 
-std::mt19937 Random::rng(std::random_device{}());
+thread_local std::mt19937 Random::rng(std::random_device{}());
 
-BenchTimer::BenchTimer(const std::string& name) :
-    name(name), start(clock_t::now()) {
+Random::Guard::Guard(std::mt19937& generator) : generator(generator) {
+    std::swap(rng, generator);
+}
 
+Random::Guard::~Guard() {
+    std::swap(rng, generator);
 }
 
-void BenchTimer::stop() {
-    assert(!stopped);
-    doStop();
+#ifdef PROFILE
+
+thread_local Profiler::Buffer Profiler::buffer;
+
+namespace {
+    std::mutex profilerMutex;
+    /* guarded by profilerMutex */
+    std::vector<std::pair<const char*, int>> sites;
+    std::vector<Profiler::Stats*> liveBuffers;
+    Profiler::Stats retired[Profiler::MAX_SITES];
+
+    /* cycles are turned into time by their rate since the start */
+    const auto startTime = std::chrono::steady_clock::now();
+    const Profiler::cycles_t startCycles = Profiler::now();
+
+    /* stats of a finished thread outlive it */
+    struct Registration {
+        Profiler::Stats* stats = nullptr;
+
+        ~Registration() {
+            std::lock_guard<std::mutex> lock(profilerMutex);
+            for (int i = 0; i < Profiler::MAX_SITES; ++i)
+                retired[i].merge(stats[i]);
+            liveBuffers.erase(std::find(all(liveBuffers), stats));
+        }
+    };
+
+    thread_local Registration registration;
 }
 
-void BenchTimer::doStop() {
-    assert(!stopped);
-    stopped = true;
-    auto end = clock_t::now();
-    auto delta = std::chrono::duration<double>(end - start).count();
-    std::cerr << name << ": " << delta * 1000 << "ms" << std::endl; 
+void Profiler::Stats::merge(const Stats& other) {
+    if (!other.calls)
+        return;
+    min = calls == 0 ? other.min : std::min(min, other.min);
+    max = std::max(max, other.max);
+    calls += other.calls;
+    total += other.total;
+    for (int b = 0; b < BUCKETS; ++b)
+        histogram[b] += other.histogram[b];
 }
 
-BenchTimer::~BenchTimer() {
-    if (!stopped)
-        doStop();
+int Profiler::site(const char* name, int line) {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    assert(sites.size() < MAX_SITES);
+    sites.emplace_back(name, line);
+    return sites.size() - 1;
 }
+
+void Profiler::registerBuffer() {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    buffer.registered = true;
+    registration.stats = buffer.stats;
+    liveBuffers.push_back(buffer.stats);
+}
+
+void Profiler::report(std::ostream& out, const char* title) {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    double nsPerCycle = seconds * 1e9 / std::max<cycles_t>(now() - startCycles, 1);
+
+    Stats merged[MAX_SITES] = {};
+    for (int i = 0; i < MAX_SITES; ++i) {
+        merged[i] = retired[i];
+        retired[i] = {};
+        for (Stats* stats : liveBuffers) {
+            merged[i].merge(stats[i]);
+            stats[i] = {};
+        }
+    }
+
+    auto flags = out.flags();
+    out << "Profile of " << title << ":\n" << std::fixed << std::setprecision(0)
+        << std::setw(10) << "calls" << std::setw(12) << "total ms"
+        << std::setw(10) << "mean ns" << std::setw(10) << "min ns"
+        << std::setw(10) << "max ns" << "  scope" << std::endl;
+    for (int i = 0; i < int(sites.size()); ++i) {
+        const Stats& stats = merged[i];
+        if (!stats.calls)
+            continue;
+        out << std::setw(10) << stats.calls
+            << std::setw(12) << std::setprecision(2) << stats.total * nsPerCycle / 1e6
+            << std::setprecision(0)
+            << std::setw(10) << stats.total * nsPerCycle / stats.calls
+            << std::setw(10) << stats.min * nsPerCycle
+            << std::setw(10) << stats.max * nsPerCycle
+            << "  " << sites[i].first << ":" << sites[i].second << std::endl;
+
+        /* share of the calls below the upper bound of every bucket,
+         * the rare ones are left out, the max shows the tail */
+        out << std::string(10, ' ');
+        for (int b = 0; b < BUCKETS; ++b)
+            if (100 * stats.histogram[b] >= stats.calls)
+                out << " <" << std::ldexp(nsPerCycle, b + 1) << "ns "
+                    << 100 * stats.histogram[b] / stats.calls << "%";
+        out << std::endl;
+    }
+    out.flags(flags);
+}
+
+#endif /* PROFILE */
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <chrono>
 #include <random>
+#include <cassert>
+#include <atomic>
 
 #define all(x) (x).begin(), (x).end()
 
@@ -81,6 +83,54 @@ bool operator==(const Point& a, const Point& b);
 bool operator!=(const Point& a, const Point& b);
 bool operator<(const Point& a, const Point& b);
 
+/* vector with inline storage of fixed capacity, it never touches
+ * the allocator and is trivially copyable whenever T is */
+template<typename T, int CAPACITY>
+class InlineVector {
+public:
+    static constexpr int MAX_SIZE = CAPACITY;
+
+    void push_back(const T& elem) {
+        assert(count < CAPACITY);
+        elems[count++] = elem;
+    }
+    void pop_back() {
+        assert(count > 0);
+        --count;
+    }
+    void clear() { count = 0; }
+
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T& operator[](int i) { return elems[i]; }
+    const T& operator[](int i) const { return elems[i]; }
+    T& back() { return elems[count - 1]; }
+    const T& back() const { return elems[count - 1]; }
+
+    T* begin() { return elems; }
+    T* end() { return elems + count; }
+    const T* begin() const { return elems; }
+    const T* end() const { return elems + count; }
+
+private:
+    T elems[CAPACITY];
+    int count = 0;
+};
+
+/* limit of a single search, either time in ms or a number of
+ * iterations - node expansions, playouts or generations, whichever
+ * the agent does; iterations do not depend on the load of the machine */
+struct Budget {
+    enum class Type { time, iterations };
+
+    Type type;
+    int limit;
+
+    Budget(int timeLimit);
+    static Budget iterations(int count);
+};
+
 class Timer {
 public:
     using time_t = float;
@@ -88,45 +138,132 @@ public:
 
     Timer() = default;
     Timer(time_t timeLimit);
+    Timer(const Budget& budget);
     void set(float timeLimit);
+    /* always true with an iteration budget */
     bool isTimeLeft() const;
+    /* takes count iterations of the budget, false if they do not
+     * fit in it, with a time budget it is isTimeLeft */
+    bool spend(int count = 1) const;
     time_t getTimePassed() const;
     time_t getTimeLeft() const;
     void reset();
 
 private:
     static constexpr int margin = 5;
+    Budget::Type type = Budget::Type::time;
     time_t timeLimit;
+    int iterations = 0;
+    mutable std::atomic<int> spent{0};
     clock_t::time_point start;
 };
 
-class BenchTimer {
-public:
-    using clock_t = std::chrono::high_resolution_clock;
+#ifdef PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
-    BenchTimer(const std::string& name="BenchTimer");
-    void stop();
-    ~BenchTimer();
+/* aggregating profiler of the scopes marked with BENCH(), every thread
+ * records into its own buffer without any synchronization, a report
+ * merges them, so it may be made only when no other thread is inside
+ * a marked scope - between turns or after the games */
+class Profiler {
+public:
+    using cycles_t = uint64_t;
+
+    static constexpr int MAX_SITES = 64;
+    /* bucket b counts scopes of [2^b, 2^(b+1)) cycles */
+    static constexpr int BUCKETS = 40;
+
+    /* zero initialized, so that thread buffers need no constructor */
+    struct Stats {
+        uint64_t calls;
+        cycles_t total;
+        cycles_t min;
+        cycles_t max;
+        uint64_t histogram[BUCKETS];
+
+        inline void add(cycles_t cycles);
+        void merge(const Stats& other);
+    };
+
+    /* id of a marked scope, taken once per scope */
+    static int site(const char* name, int line);
+    static inline cycles_t now();
+    static inline void record(int site, cycles_t cycles);
+    /* stats of all the threads, the live ones are reset */
+    static void report(std::ostream& out, const char* title);
 
 private:
-    void doStop();
+    struct Buffer {
+        Stats stats[MAX_SITES];
+        bool registered;
+    };
+
+    static void registerBuffer();
+
+    static thread_local Buffer buffer;
+};
+
+void Profiler::Stats::add(cycles_t cycles) {
+    min = calls == 0 ? cycles : std::min(min, cycles);
+    max = std::max(max, cycles);
+    ++calls;
+    total += cycles;
+    ++histogram[std::min(BUCKETS - 1, 63 - __builtin_clzll(cycles | 1))];
+}
+
+Profiler::cycles_t Profiler::now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void Profiler::record(int site, cycles_t cycles) {
+    if (!buffer.registered)
+        registerBuffer();
+    buffer.stats[site].add(cycles);
+}
+
+class ProfileScope {
+public:
+    ProfileScope(int site) : site(site), start(Profiler::now()) {}
+    ~ProfileScope() { Profiler::record(site, Profiler::now() - start); }
 
 private:
-    std::string name;
-    clock_t::time_point start;
-    bool stopped = false;
+    int site;
+    Profiler::cycles_t start;
 };
 
-#if 0
 #define COMBINE1(X,Y) X##Y  // helper macro
 #define COMBINE(X,Y) COMBINE1(X,Y)
-#define BENCH() BenchTimer COMBINE(benchTimer, __LINE__)(__PRETTY_FUNCTION__)
+#define BENCH() \
+    static const int COMBINE(benchSite, __LINE__) = Profiler::site(__PRETTY_FUNCTION__, __LINE__); \
+    ProfileScope COMBINE(benchScope, __LINE__)(COMBINE(benchSite, __LINE__))
+#define PROFILE_REPORT(title) Profiler::report(std::cerr, title)
 #else
 #define BENCH()
-#endif
+#define PROFILE_REPORT(title)
+#endif /* PROFILE */
 
 namespace Random {
-    extern std::mt19937 rng;
+    /* every thread has its own generator seeded on first use */
+    extern thread_local std::mt19937 rng;
+
+    /* draws of the thread come from the given generator
+     * for the lifetime of the guard */
+    class Guard {
+    public:
+        Guard(std::mt19937& generator);
+        ~Guard();
+
+    private:
+        std::mt19937& generator;
+    };
 
     template<typename T>
     using T_Int = std::enable_if_t<
@@ -4,7 +4,7 @@ Dummy::Dummy() {
     name = "Dummy";
 }
 
-Action Dummy::getAction(const GameState& game, const int) {
+Action Dummy::getAction(const GameState& game, const Budget&) {
     auto me = game.getPlayer(myid);
     assert(me);
     if (firstAction) {
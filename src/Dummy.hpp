@@ -8,7 +8,7 @@ public:
     Dummy();
 
     Action getAction(const GameState& game,
-                     const int timeLimit) override;
+                     const Budget& budget) override;
 
 private:
     bool firstAction = true;
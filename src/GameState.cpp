@@ -3,16 +3,12 @@
 
 #include <cassert>
 #include <cstring>
-#include <map>
-#include <set>
-#include <functional>
 #include <algorithm>
 #include <tuple>
 #undef all
-#include <bitset>
 #define all(x) (x).begin(), (x).end()
 
-int GameState::myid;
+thread_local int GameState::myid;
 
 std::istream& operator>>(std::istream& in, GameState& game) {
     for (int y = 0; y < game.H; ++y) {
@@ -21,10 +17,10 @@ std::istream& operator>>(std::istream& in, GameState& game) {
             in >> c;
             std::cerr << c;
             assert(c == '.' || c == 'X' || std::isdigit(c));
-            game.board.board[y][x] =
+            game.board.set(x, y,
                 c == '.' ? Cell::empty :
                 c == 'X' ? Cell::wall :
-                Cell(c - '0');
+                Cell(c - '0'));
         }
         std::cerr << '\n';
     }
@@ -62,6 +58,7 @@ std::istream& operator>>(std::istream& in, GameState& game) {
     }
 
     std::cerr.flush();
+    game.hash = game.computeHash();
 
     return in;
 }
@@ -69,95 +66,283 @@ std::istream& operator>>(std::istream& in, GameState& game) {
 void Explosions::explode(int x, int y, int time, int ownerId) {
     if (e[y][x].time < time)
         return;
-    e[y][x].time = time;
+    assert(1 <= time && time <= MAX_TIME);
+    if (e[y][x].time != time) {
+        if (e[y][x].time != ExplosionInfo::NONE)
+            ticks[int(e[y][x].time)].reset(x, y);
+        ticks[time].set(x, y);
+        e[y][x].time = time;
+    }
     assert(0 <= ownerId && ownerId < 4);
     e[y][x].ownerMask |= 1 << ownerId;
+    owners[ownerId].set(x, y);
 }
 
-bool Explosions::isOwner(int x, int y, int id) const {
-    return e[y][x].time != ExplosionInfo::NONE && (e[y][x].ownerMask & 1 << id);
+/* move the timeline one tick forward, cells exploding now are cleared */
+void Explosions::advance() {
+    ticks[1].forEach([this](int x, int y) {
+        e[y][x] = ExplosionInfo();
+    });
+    for (int t = 2; t <= MAX_TIME; ++t)
+        ticks[t].forEach([this](int x, int y) {
+            --e[y][x].time;
+        });
+
+    for (auto& owner : owners)
+        owner = owner.andNot(ticks[1]);
+    for (int t = 1; t < MAX_TIME; ++t)
+        ticks[t] = ticks[t + 1];
+    ticks[MAX_TIME] = BitBoard();
 }
 
-Explosions GameState::getExplosions() const {
-    std::map<Point, Bomb> bombsAt;
-    std::array<std::vector<Point>, MAX_BOMB_TIME> explodeAtTime;
-    for (const auto& bomb : bombs) {
-        auto bPoint = point(bomb);
-        bombsAt[bPoint] = bomb;
-        explodeAtTime[bomb.time - 1].push_back(bPoint);
-    }
+bool Explosions::operator==(const Explosions& other) const {
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+            if (e[y][x].time != other.e[y][x].time ||
+                e[y][x].ownerMask != other.e[y][x].ownerMask)
+                return false;
+    for (int t = 0; t <= MAX_TIME; ++t)
+        if (!(ticks[t] == other.ticks[t]))
+            return false;
+    for (int i = 0; i < MAX_PLAYERS; ++i)
+        if (!(owners[i] == other.owners[i]))
+            return false;
+    return true;
+}
 
-    std::map<Point, Item> itemsAt;
-    for (const auto& item : items)
-        itemsAt[point(item)] = item;
+namespace {
+    /* flat per-cell view of the board used to propagate blasts,
+     * chain reactions are resolved with an explicit worklist */
+    class BlastEngine {
+    public:
+        /* cells from cleared are treated as already blown up */
+        BlastEngine(const GameState& game, const BitBoard& cleared = BitBoard());
+
+        /* explode bombs with the given timer and everything they chain,
+         * then clear the hit boxes, items and bombs from the board */
+        void explodeAt(int time, Explosions& explosions);
+
+    private:
+        static constexpr int H = GameState::H;
+        static constexpr int W = GameState::W;
+        static constexpr int CELLS = H * W;
+        static constexpr int8_t NONE = -1;
+
+        void push(int cell);
+        void blast(const Bomb& bomb, int time, Explosions& explosions);
+
+        const GameState& game;
+        BitBoard boxes;
+        int8_t bombAt[CELLS];
+        bool itemAt[CELLS] = {};
+        bool hit[CELLS] = {};
+        int8_t worklist[CELLS];
+        int worklistSize = 0;
+        int16_t hitCells[CELLS];
+        int hitCount = 0;
+    };
 
-    Board boardC = this->board;
-    assert(&boardC != &this->board);
-    Explosions explosions;
-    for (int y = 0; y < H; ++y)
-        for (int x = 0; x < W; ++x) {
-            assert(explosions.e[y][x].time == ExplosionInfo::NONE);
-            assert(explosions.e[y][x].ownerMask == 0);
+    BlastEngine::BlastEngine(const GameState& game, const BitBoard& cleared) :
+        game(game), boxes(game.board.boxes.andNot(cleared)) {
+        static_assert(GameState::MAX_BOMBS <= INT8_MAX,
+            "Bomb indices have to fit into int8_t!");
+        std::fill(bombAt, bombAt + CELLS, NONE);
+        for (int i = 0; i < game.bombs.size(); ++i) {
+            const auto& bomb = game.bombs[i];
+            if (!cleared.get(bomb.x, bomb.y))
+                bombAt[BitBoard::index(bomb.x, bomb.y)] = i;
         }
+        for (const auto& item : game.items)
+            if (!cleared.get(item.x, item.y))
+                itemAt[BitBoard::index(item.x, item.y)] = true;
+    }
 
-    std::set<Point> visited;
-    std::function<void(const Bomb&, int)> bombFloodFill = [&](
-        const Bomb& bomb, int time) {
-
-        if (visited.count(point(bomb)))
-            return;
+    void BlastEngine::push(int cell) {
+        hit[cell] = true;
+        hitCells[hitCount++] = cell;
+        if (bombAt[cell] != NONE)
+            worklist[worklistSize++] = bombAt[cell];
+    }
 
-        visited.insert(point(bomb));
+    void BlastEngine::blast(const Bomb& bomb, int time, Explosions& explosions) {
         explosions.explode(bomb.x, bomb.y, time, bomb.owner);
 
-        for (int i = 0; i < DIR_COUNT - 1; ++i)
+        for (int i = 0; i < GameState::DIR_COUNT - 1; ++i)
             for (int l = 1; l < bomb.range; ++l) {
-                int nx = bomb.x + l * dx[i];
-                int ny = bomb.y + l * dy[i];
-                if (!isInBounds(nx, ny))
-                    continue;
-                if (boardC.board[ny][nx] == Cell::wall)
+                int nx = bomb.x + l * GameState::dx[i];
+                int ny = bomb.y + l * GameState::dy[i];
+                if (!GameState::isInBounds(nx, ny))
+                    break;
+                if (game.board.isWall(nx, ny))
                     break;
 
                 explosions.explode(nx, ny, time, bomb.owner);
-                auto nPoint = point(nx, ny);
 
-                bool stopped = false;
-                if (bombsAt.count(nPoint)) {
-                    assert(!itemsAt.count(nPoint));
-                    stopped = true;
-                    bombFloodFill(bombsAt[nPoint], time);
-                }
-                else if (itemsAt.count(nPoint)) {
-                    stopped = true;
-                    assert(point(itemsAt[nPoint]) == nPoint);
-                    visited.insert(nPoint);
-                }
-
-                if (boardC.board[ny][nx] != Cell::empty)
-                    stopped = true;
-                if (boardC.isBox(nx, ny))
-                    visited.insert(nPoint);
-                if (stopped)
+                int cell = BitBoard::index(nx, ny);
+                if (bombAt[cell] != NONE || itemAt[cell] || boxes.get(nx, ny)) {
+                    if (!hit[cell])
+                        push(cell);
                     break;
+                }
             }
-    };
+    }
 
-    for (int t = 0; t < MAX_BOMB_TIME; ++t) {
-        visited.clear();
-        for (const auto& p : explodeAtTime[t])
-            if (bombsAt.count(p))
-                bombFloodFill(bombsAt[p], t + 1);
-        for (const auto& p : visited) {
-            bombsAt.erase(p);
-            itemsAt.erase(p);
-            boardC.board[p.y][p.x] = Cell::empty;
+    void BlastEngine::explodeAt(int time, Explosions& explosions) {
+        assert(worklistSize == 0 && hitCount == 0);
+        for (const auto& bomb : game.bombs) {
+            int cell = BitBoard::index(bomb.x, bomb.y);
+            if (bomb.time == time && bombAt[cell] != NONE && !hit[cell])
+                push(cell);
         }
+
+        while (worklistSize > 0)
+            blast(game.bombs[worklist[--worklistSize]], time, explosions);
+
+        for (int i = 0; i < hitCount; ++i) {
+            int cell = hitCells[i];
+            bombAt[cell] = NONE;
+            itemAt[cell] = false;
+            boxes.reset(cell % W, cell / W);
+            hit[cell] = false;
+        }
+        hitCount = 0;
     }
+}
+
+Explosions GameState::getExplosions() const {
+    BENCH();
+    Explosions explosions;
+    BlastEngine engine(*this);
+    for (int t = 1; t <= MAX_BOMB_TIME; ++t)
+        engine.explodeAt(t, explosions);
+    return explosions;
+}
+
+/* explosions of the state obtained by succ from prev, computed by moving
+ * the timeline of prev one tick forward, the only bombs that can be new
+ * are just placed ones with the longest timer, if one of them is placed
+ * in the blast of the older bombs or some dropped or picked up item may
+ * change the way the older bombs blast, it falls back to getExplosions() */
+Explosions GameState::getExplosions(const GameState& prev,
+        const Explosions& prevExplosions) const {
+    BENCH();
+    Explosions explosions = prevExplosions;
+    explosions.advance();
+
+    BitBoard itemsAt, prevItemsAt;
+    for (const auto& item : items)
+        itemsAt.set(item.x, item.y);
+    for (const auto& item : prev.items)
+        prevItemsAt.set(item.x, item.y);
+
+    /* picked up item no longer stops the blast that was going to hit it */
+    auto picked = prevItemsAt.andNot(itemsAt);
+    if ((picked & explosions.exploding()).any())
+        return getExplosions();
+
+    /* dropped item may stop a blast that was going through the box */
+    auto dropped = itemsAt.andNot(prevItemsAt);
+    if (dropped.any())
+        for (const auto& item : items) {
+            if (!dropped.get(item.x, item.y))
+                continue;
+            for (const auto& bomb : bombs)
+                if ((item.x == bomb.x && std::abs(item.y - bomb.y) < bomb.range) ||
+                    (item.y == bomb.y && std::abs(item.x - bomb.x) < bomb.range))
+                    return getExplosions();
+        }
+
+    /* only the earliest explosion of the cell is kept, so cells that
+     * exploded just now lost the later ones, find them again */
+    const auto& stale = prevExplosions.ticks[1];
+    if (stale.any())
+        retrace(stale, explosions);
+
+    bool placed = false;
+    for (const auto& bomb : bombs)
+        if (bomb.time == MAX_BOMB_TIME) {
+            /* caught in the older blast, so it changes the chain */
+            if (explosions.e[bomb.y][bomb.x].time != ExplosionInfo::NONE)
+                return getExplosions();
+            placed = true;
+        }
+
+    /* older bombs are gone by then, only the placed ones explode */
+    if (placed) {
+        BlastEngine engine(*this, explosions.exploding());
+        engine.explodeAt(MAX_BOMB_TIME, explosions);
+    }
+
+    assert(explosions == getExplosions());
 
     return explosions;
 }
 
+/* follow the blasts of the older bombs through stale cells, the cells
+ * that are not stale already have the right time, so they tell whether
+ * the box, item or bomb was still there when the blast came; of bombs
+ * stacked on one cell only the last one blasts, as in BlastEngine */
+void GameState::retrace(const BitBoard& stale, Explosions& explosions) const {
+    BitBoard blockers = board.boxes;
+    for (const auto& item : items)
+        blockers.set(item.x, item.y);
+    int bombAt[H * W];
+    for (int i = 0; i < bombs.size(); ++i) {
+        blockers.set(bombs[i].x, bombs[i].y);
+        bombAt[BitBoard::index(bombs[i].x, bombs[i].y)] = i;
+    }
+
+    for (int t = 1; t < MAX_BOMB_TIME; ++t)
+        for (int b = 0; b < bombs.size(); ++b) {
+            const auto& bomb = bombs[b];
+            if (explosions.e[bomb.y][bomb.x].time != t ||
+                bombAt[BitBoard::index(bomb.x, bomb.y)] != b)
+                continue;
+            for (int i = 0; i < DIR_COUNT - 1; ++i)
+                for (int l = 1; l < bomb.range; ++l) {
+                    int nx = bomb.x + l * dx[i];
+                    int ny = bomb.y + l * dy[i];
+                    if (!isInBounds(nx, ny) || board.isWall(nx, ny))
+                        break;
+                    if (stale.get(nx, ny)) {
+                        explosions.explode(nx, ny, t, bomb.owner);
+                        continue;
+                    }
+                    if (blockers.get(nx, ny) && explosions.e[ny][nx].time >= t)
+                        break;
+                }
+        }
+}
+
+namespace {
+    hash_t key(const Player& player) {
+        return Zobrist::player(player.id, player.x, player.y,
+            player.bombs, player.range);
+    }
+
+    hash_t key(const Bomb& bomb) {
+        return Zobrist::bomb(bomb.owner, bomb.x, bomb.y, bomb.time, bomb.range);
+    }
+
+    hash_t key(const Item& item) {
+        return Zobrist::item(item.x, item.y, int(item.type));
+    }
+}
+
+hash_t GameState::computeHash() const {
+    hash_t hash = 0;
+    board.boxes.forEach([this, &hash](int x, int y) {
+        hash ^= Zobrist::box(x, y, int(board.at(x, y)));
+    });
+    for (const auto& player : players)
+        hash ^= key(player);
+    for (const auto& bomb : bombs)
+        hash ^= key(bomb);
+    for (const auto& item : items)
+        hash ^= key(item);
+    return hash;
+}
+
 const Player* GameState::getPlayer(int id) const {
     const auto it = std::find_if(all(players), [id](const Player& player) { 
         return player.id == id; });
@@ -176,45 +361,65 @@ int GameState::countAllBombs(int id) const {
 /* get the next state, if actions are invalid or you die returns {} (nothing) */
 std::optional<std::pair<GameState, ExtraInfo>> GameState::succ(
         const Explosions& explosions,
-        const Actions& actions) const {
+        const JointAction& actions) const {
+    BENCH();
     if (!validActions(actions))
         return {};
 
     GameState next;
     next.board = board;
+    next.hash = hash;
     assert(next.players.empty() &&
         next.bombs.empty() &&
         next.items.empty());
     ExtraInfo extra;
 
-    /* calculate items created by box destruction */
-    std::map<Point, Item> allItems;
+    /* calculate items created by box destruction, items are kept per
+     * cell and the successor gets them in the order of points (column
+     * by column) as before, players are kept per id */
+    BitBoard itemsAt;
+    Item itemAt[BitBoard::CELLS];
     for (int y = 0; y < H; ++y)
         for (int x = 0; x < W; ++x)
             if (explosions.e[y][x].time == 1 && board.isBox(x, y)) {
-                next.board.board[y][x] = Cell::empty;
-                if (board.isDrop(x, y))
-                    allItems[point(x, y)] = board.drop(x, y);
+                next.board.set(x, y, Cell::empty);
+                next.hash ^= Zobrist::box(x, y, int(board.at(x, y)));
+                if (board.isDrop(x, y)) {
+                    auto item = board.drop(x, y);
+                    itemsAt.set(x, y);
+                    itemAt[BitBoard::index(x, y)] = item;
+                    next.hash ^= key(item);
+                }
                 for (int i = 0; i < MAX_PLAYERS; ++i)
                     if (explosions.e[y][x].ownerMask & 1 << i)
                         ++extra.boxesDestroyed[i];
             }
 
     /* calculate survived players */
-    std::map<int, Player> playersAlive;
+    Player playersAlive[MAX_PLAYERS];
+    bool isAlive[MAX_PLAYERS] = {};
     for (const auto& player : this->players)
         if (explosions.e[player.y][player.x].time == 1) {
             if (player.id == myid)
                 return {};
+            next.hash ^= key(player);
         }
         else
+        {
             playersAlive[player.id] = player;
+            isAlive[player.id] = true;
+        }
 
     /* calculate survived items */
     for (const auto& item : this->items) {
         assert(explosions.e[item.y][item.x].time >= 1);
         if (explosions.e[item.y][item.x].time > 1)
-            allItems[point(item)] = item;
+        {
+            itemsAt.set(item.x, item.y);
+            itemAt[BitBoard::index(item.x, item.y)] = item;
+        }
+        else
+            next.hash ^= key(item);
     }
 
     /* calculate survived bombs */
@@ -222,31 +427,39 @@ std::optional<std::pair<GameState, ExtraInfo>> GameState::succ(
     for (int i = 0; i < MAX_PLAYERS; ++i)
         assert(bombsExploded[i] == 0);
 
-    for (auto bomb : this->bombs)
+    for (auto bomb : this->bombs) {
+        next.hash ^= key(bomb);
         if (explosions.e[bomb.y][bomb.x].time == 1)
             ++bombsExploded[bomb.owner];
         else {
             --bomb.time;
             next.bombs.push_back(bomb);
+            next.hash ^= key(bomb);
         }
+    }
 
     /* calculate actions influence */
-    std::set<Point> playerAt;
-    for (auto [id, player] : playersAlive) {
+    BitBoard playerAt;
+    for (int id = 0; id < MAX_PLAYERS; ++id) {
+        if (!isAlive[id])
+            continue;
+        auto player = playersAlive[id];
         assert(id == player.id);
-        if (actions.count(id)) {
+        next.hash ^= key(player);
+        if (actions.has(id)) {
             const auto& action = actions.at(id);
-            if (action.type == ActionType::bomb)
+            if (action.type == ActionType::bomb) {
                 next.bombs.push_back(player.placeBomb());
+                next.hash ^= key(next.bombs.back());
+            }
 
             if (point(action) != point(player)) {
                 assert(std::abs(action.x - player.x) + std::abs(action.y - player.y) == 1);
                 player.x = action.x;
                 player.y = action.y;
 
-                auto p = point(player);
-                if (allItems.count(p))
-                    switch (allItems[p].type) {
+                if (itemsAt.get(player.x, player.y))
+                    switch (itemAt[BitBoard::index(player.x, player.y)].type) {
                         case ItemType::bomb:
                             ++extra.bombsIncrease[id];
                             ++player.bombs;
@@ -262,25 +475,37 @@ std::optional<std::pair<GameState, ExtraInfo>> GameState::succ(
         }
 
         player.bombs += bombsExploded[player.id];
-        playerAt.insert(point(player));
+        playerAt.set(player.x, player.y);
         next.players.push_back(player);
+        next.hash ^= key(player);
+    }
+
+    for (int x = 0; x < W; ++x) {
+        if (!(itemsAt & BitBoard::column(x)).any())
+            continue;
+        for (int y = 0; y < H; ++y)
+            if (itemsAt.get(x, y)) {
+                const auto& item = itemAt[BitBoard::index(x, y)];
+                if (!playerAt.get(x, y))
+                    next.items.push_back(item);
+                else
+                    next.hash ^= key(item);
+            }
     }
 
-    for (const auto& [p, item] : allItems)
-        if (!playerAt.count(p))
-            next.items.push_back(item);
+    assert(next.hash == next.computeHash());
 
     return std::make_pair(next, extra);
 }
 
 /* get technically valid actions - you may die, but technically you can go there */
-bool GameState::validActions(const Actions& actions) const {
-    std::set<Point> bombsAt;
+bool GameState::validActions(const JointAction& actions) const {
+    BitBoard bombsAt;
     for (const auto& bomb : bombs)
-        bombsAt.insert(point(bomb));
+        bombsAt.set(bomb.x, bomb.y);
 
     for (const auto& player : players)
-        if (actions.count(player.id)) {
+        if (actions.has(player.id)) {
             const auto& action = actions.at(player.id);
             if (std::abs(action.x - player.x) + std::abs(action.y - player.y) >= 2)
                 return false;
@@ -288,16 +513,16 @@ bool GameState::validActions(const Actions& actions) const {
                 return false;
             auto aPoint = point(action), pPoint = point(player);
             if (aPoint != pPoint) {
-                if (board.board[action.y][action.x] != Cell::empty)
+                if (!board.isEmpty(action.x, action.y))
                     return false;
-                if (bombsAt.count(aPoint))
+                if (bombsAt.get(action.x, action.y))
                     return false;
             }
             if (action.type == ActionType::bomb) {
                 assert(player.bombs >= 0);
                 if (player.bombs == 0)
                     return false;
-                if (bombsAt.count(pPoint))
+                if (bombsAt.get(player.x, player.y))
                     return false;
             }
         }
@@ -305,148 +530,173 @@ bool GameState::validActions(const Actions& actions) const {
     return true;
 }
 
-/* get all valid actions in the current state (your actions) */
-std::vector<Action> GameState::getActions() const {
-    std::vector<Action> actions;
-    actions.reserve(MAX_ACTIONS);
+/* codes of the actions of player id that validActions accepts,
+ * computed with a single pass over the bombs */
+ActionMask GameState::getActionMask(int id) const {
+    auto player = getPlayer(id);
+    assert(player);
 
-    auto me = getPlayer(myid);
-    int posX = me->x, posY = me->y;
-
-    for(int i = 0; i < DIR_COUNT; i++)
-        for (const auto& actionType : actionTypes) {
-            Action action = {actionType, posX + dx[i], posY + dy[i]};
-            if(validActions({{myid, action}}))
-            {
-                actions.push_back(action);
-            }
-        }
+    /* bit dir set iff there is a bomb in that direction */
+    int bombDirs = 0;
+    for (const auto& bomb : bombs) {
+        int ddx = bomb.x - player->x, ddy = bomb.y - player->y;
+        for (int i = 0; i < DIR_COUNT; ++i)
+            bombDirs |= (ddx == dx[i] && ddy == dy[i]) << i;
+    }
+    constexpr int STAY = DIR_COUNT - 1;
+    bool canBomb = player->bombs > 0 && !(bombDirs >> STAY & 1);
+
+    ActionMask mask = 0;
+    for (int i = 0; i < DIR_COUNT; ++i) {
+        int nx = player->x + dx[i], ny = player->y + dy[i];
+        bool canMove = i == STAY || (isInBounds(nx, ny) &&
+            board.isEmpty(nx, ny) && !(bombDirs >> i & 1));
+        mask |= canMove << encode(i, ActionType::move);
+        mask |= (canMove && canBomb) << encode(i, ActionType::bomb);
+    }
 
-    return actions;
+    return mask;
 }
 
 /* check if you can survive assuming you just done your move in 
  * the current round */
 bool GameState::canSurvive(const Explosions& explosions) const {
+    return getSurvivalInfo(explosions).canSurvive();
+}
+
+/* breadth first search over the cells reachable before each explosion
+ * tick, one bitboard expansion per tick */
+SurvivalInfo GameState::getSurvivalInfo(const Explosions& explosions) const {
+    SurvivalInfo info;
     auto me = getPlayer(myid);
     if (!me)
-        return false;
-    if (explosions.e[me->y][me->x].time == 1)
-        return false;
-
-    if (explosions.e[me->y][me->x].time == ExplosionInfo::NONE)
-        return true;
+        return info;
 
     int maxBombTime = 0;
-    std::set<Point> bombAt;
+    BitBoard bombCells;
     for (const auto& bomb : bombs) {
         if (bomb.time > maxBombTime)
             maxBombTime = bomb.time;
-        bombAt.insert(point(bomb));
+        bombCells.set(bomb.x, bomb.y);
     }
     assert(maxBombTime <= MAX_BOMB_TIME);
 
-    static std::bitset<H * W> dp, next;
-    dp.reset();
-    next.reset();
-    dp[me->y * W + me->x] = true;
+    BitBoard neverExploding = ~explosions.exploding();
+    /* boxes and bombs there are gone, so they do not block */
+    BitBoard exploded;
+    BitBoard reachable;
+    reachable.set(me->x, me->y);
 
     for (int t = 0; t < maxBombTime; ++t) {
-        bool survive = false;
-
-        for (int y = 0; y < H; ++y)
-            for (int x = 0; x < W; ++x) {
-                if (!dp[y * W + x])
-                    continue;
-                if (explosions.e[y][x].time == t + 1)
-                    continue;
-                if (explosions.e[y][x].time == ExplosionInfo::NONE)
-                    return true;
-                for (int i = 0; i < DIR_COUNT; ++i) {
-                    int nx = x + dx[i];
-                    int ny = y + dy[i];
-                    if (!isInBounds(nx, ny))
-                        continue;
-                    if (next[ny * W + nx])
-                        continue;
-                    if (board.board[ny][nx] == Cell::wall)
-                        continue;
-                    if (board.isBox(nx, ny) && explosions.e[ny][nx].time >= t + 1)
-                        continue;
-                    if (point(nx, ny) != point(x, y) && bombAt.count(point(nx, ny)) && explosions.e[ny][nx].time >= t + 1)
-                        continue;
-                    next[ny * W + nx] = true;
-                    survive = true;
-                }
-            }
+        auto alive = reachable.andNot(explosions.ticks[t + 1]);
+        auto safeCells = alive & neverExploding;
+        if (safeCells.any()) {
+            info.safeTick = t;
+            info.safeCells = safeCells;
+            return info;
+        }
 
-        if (!survive)
-            return false;
+        /* standing still is always possible, even on a bomb */
+        auto blocked = board.walls | (board.boxes | bombCells).andNot(exploded);
+        reachable = alive | alive.neighbours().andNot(blocked);
+        if (!reachable.any())
+            return info;
 
-        dp = next;
-        next.reset();
+        exploded |= explosions.ticks[t + 1];
     }
 
-    return true;
+    info.safeTick = maxBombTime;
+    info.safeCells = reachable;
+    return info;
 }
 
-/* get possible actions, assuming you do not want to die
- * and all the other players will place the bomb where
- * they stand right now, if all actions with pessimistic
- * assumption are forbidden, return without that assumption,
- * if still all actions are forbidden, return all actions */
-std::set<Action> GameState::_getPossibleActions(Actions actions) const {
-    std::set<Action> possibleActions;
-    auto explosions = getExplosions();
+namespace {
+    /* safe actions of recently seen states, direct mapped by the hash,
+     * kept per thread so that searches running in parallel do not
+     * need to synchronize */
+    struct SafeActionsEntry {
+        hash_t hash;
+        int id;
+        ActionMask mask;
+        bool filled; /* zero initialized, keeps the cache out of the binary */
+    };
+
+    constexpr int SAFE_ACTIONS_CACHE_SIZE = 1 << 12;
+    thread_local SafeActionsEntry safeActionsCache[SAFE_ACTIONS_CACHE_SIZE];
+}
+
+/* actions out of candidates after which you can still survive,
+ * assuming the other players do the given actions */
+ActionMask GameState::_getSafeActions(const Explosions& explosions,
+        JointAction actions, ActionMask candidates) const {
     auto me = getPlayer(myid);
     assert(me);
 
-    for (int i = 0; i < DIR_COUNT; ++i)
-        for (const auto& actionType : actionTypes) {
-            Action myAction = {actionType, me->x + dx[i], me->y + dy[i]};
-            actions[myid] = myAction;
-            auto succInfo = succ(explosions, actions);
-            if (!succInfo)
-                continue;
-            const auto& [nextState, extra] = succInfo.value();
-            assert(nextState.getPlayer(myid));
-            if (nextState.canSurvive(nextState.getExplosions()))
-                possibleActions.insert(myAction);
-        }
+    ActionMask safeActions = 0;
+    for (; candidates; candidates &= candidates - 1) {
+        ActionCode code = __builtin_ctz(candidates);
+        actions.set(myid, decode(code, me->x, me->y));
+        auto succInfo = succ(explosions, actions);
+        if (!succInfo)
+            continue;
+        const auto& [nextState, extra] = succInfo.value();
+        assert(nextState.getPlayer(myid));
+        if (nextState.canSurvive(nextState.getExplosions(*this, explosions)))
+            safeActions |= 1 << code;
+    }
 
-    return possibleActions;
+    return safeActions;
 }
 
-std::set<Action> GameState::getPossibleActions() const {
-    std::set<Point> bombsAt;
+/* your actions after which you can survive even if every enemy that
+ * can places a bomb now, if there are none - assuming that they do
+ * not, if there are still none - all the actions */
+ActionMask GameState::getSafeActions() const {
+    BENCH();
+    auto& entry = safeActionsCache[hash & (SAFE_ACTIONS_CACHE_SIZE - 1)];
+    if (entry.filled && entry.id == myid && entry.hash == hash)
+        return entry.mask;
+
+    BitBoard bombCells;
     for (const auto& bomb : bombs)
-        bombsAt.insert(point(bomb));
+        bombCells.set(bomb.x, bomb.y);
 
-    Actions enemyActions;
-    const Player* me = nullptr;
+    JointAction enemyActions;
     for (const auto& player : players)
         if (player.id != myid) {
             assert(player.bombs >= 0);
-            if (player.bombs == 0 || bombsAt.count(point(player)))
+            if (player.bombs == 0 || bombCells.get(player.x, player.y))
                 continue;
-            enemyActions[player.id] = { ActionType::bomb, player.x, player.y };
+            enemyActions.set(player.id, {ActionType::bomb, player.x, player.y});
         }
-        else
-            me = &player;
-    assert(me);
 
-    auto possibleActions = _getPossibleActions(enemyActions);
-    if (possibleActions.empty()) {
-        possibleActions = _getPossibleActions({});
+    auto explosions = getExplosions();
+    auto candidates = getActionMask(myid);
 
-        if (possibleActions.empty())
-            for (int i = 0; i < DIR_COUNT; ++i)
-                for (const auto& actionType : actionTypes)
-                    possibleActions.insert({actionType, me->x + dx[i], me->y + dy[i]});
+    auto safeActions = _getSafeActions(explosions, enemyActions, candidates);
+    if (!safeActions) {
+        safeActions = _getSafeActions(explosions, JointAction(), candidates);
+        if (!safeActions)
+            safeActions = (1 << ACTION_CODES) - 1;
     }
-    assert(!possibleActions.empty());
 
-    return possibleActions;
+    entry = {hash, myid, safeActions, true};
+    return safeActions;
+}
+
+Bomb::Bomb(int owner, int x, int y, int time, int range) :
+    owner(owner), x(x), y(y), time(time), range(range) {
+
+}
+
+Player::Player(int id, int x, int y, int bombs, int range) :
+    id(id), x(x), y(y), bombs(bombs), range(range) {
+
+}
+
+Item::Item(int x, int y, ItemType type) :
+    x(x), y(y), type(type) {
+
 }
 
 Bomb Player::placeBomb() {
@@ -456,18 +706,18 @@ Bomb Player::placeBomb() {
 }
 
 std::ostream& operator<<(std::ostream& out, const Bomb& bomb) {
-    return out << "owner: " << bomb.owner
-               << ", (x: " << bomb.x << ", y: " <<  bomb.y
-               << "), time: " << bomb.time << ", range: " << bomb.range; 
+    return out << "owner: " << int(bomb.owner)
+               << ", (x: " << int(bomb.x) << ", y: " <<  int(bomb.y)
+               << "), time: " << int(bomb.time) << ", range: " << int(bomb.range);
 }
 
 std::ostream& operator<<(std::ostream& out, const Player& player) {
-    return out << "id: " << player.id
-               << ", (x: " << player.x << ", y: " <<  player.y
-               << "), bombs: " << player.bombs << ", range: " << player.range; 
+    return out << "id: " << int(player.id)
+               << ", (x: " << int(player.x) << ", y: " <<  int(player.y)
+               << "), bombs: " << int(player.bombs) << ", range: " << int(player.range);
 }
 
 std::ostream& operator<<(std::ostream& out, const Item& item) {
     return out << "type: " << (item.type == ItemType::range ? "RANGE" : "BOMB")
-               << ", (x: " << item.x << ", y: " <<  item.y;
+               << ", (x: " << int(item.x) << ", y: " <<  int(item.y);
 }
@@ -3,12 +3,16 @@
 
 #include "Common.hpp"
 #include "Action.hpp"
+#include "BitBoard.hpp"
+#include "Zobrist.hpp"
 
 #include <iostream>
 #include <vector>
 #include <cassert>
 #include <climits>
-#include <set>
+#include <optional>
+#include <cstdint>
+#include <type_traits>
 
 enum class Cell {
     wall = -2,
@@ -18,23 +22,31 @@ enum class Cell {
     bombBox = 2
 };
 
-enum class ItemType : int {
+enum class ItemType : int8_t {
     range = 1,
     bomb = 2
 };
 
+/* entities use the smallest types that fit the 11x13 board,
+ * so that GameState stays compact and trivially copyable */
 struct Bomb {
-    int owner;
-    int x, y;
-    int time, range;
+    int8_t owner;
+    int8_t x, y;
+    int8_t time, range;
+
+    Bomb() = default;
+    Bomb(int owner, int x, int y, int time, int range);
 
     friend std::ostream& operator<<(std::ostream& out, const Bomb& bomb);
 };
 
 struct Player {
-    int id;
-    int x, y;
-    int bombs, range;
+    int8_t id;
+    int8_t x, y;
+    int8_t bombs, range;
+
+    Player() = default;
+    Player(int id, int x, int y, int bombs, int range);
 
     Bomb placeBomb();
 
@@ -42,9 +54,12 @@ struct Player {
 };
 
 struct Item {
-    int x, y;
+    int8_t x, y;
     ItemType type;
 
+    Item() = default;
+    Item(int x, int y, ItemType type);
+
     friend std::ostream& operator<<(std::ostream& out, const Item& item);
 };
 
@@ -57,33 +72,120 @@ struct ExplosionInfo {
 struct Explosions {
     static constexpr int H = 11;
     static constexpr int W = 13;
+    static constexpr int MAX_TIME = 8;
+    static constexpr int MAX_PLAYERS = 4;
 
     ExplosionInfo e[H][W];
+    /* the same information as bitboards, ticks[t] holds cells
+     * exploding at time t, owners[id] cells in the blast of player id */
+    BitBoard ticks[MAX_TIME + 1];
+    BitBoard owners[MAX_PLAYERS];
 
     void explode(int x, int y, int time, int ownerId);
-    bool isOwner(int x, int y, int id) const;
+    void advance();
+    inline BitBoard exploding() const;
+    inline bool isOwner(int x, int y, int id) const;
+    inline double ownedReward(const BitBoard& cells, int id, double reward) const;
+
+    bool operator==(const Explosions& other) const;
 };
 
+/* all the cells that explode at some time */
+BitBoard Explosions::exploding() const {
+    BitBoard cells;
+    for (int t = 1; t <= MAX_TIME; ++t)
+        cells |= ticks[t];
+    return cells;
+}
+
+bool Explosions::isOwner(int x, int y, int id) const {
+    return owners[id].get(x, y);
+}
+
+/* sum of (reward - explosion time) over cells in the blast of player id */
+double Explosions::ownedReward(const BitBoard& cells, int id, double reward) const {
+    auto owned = cells & owners[id];
+    int timeSum = 0;
+    for (int t = 1; t <= MAX_TIME; ++t)
+        timeSum += t * (owned & ticks[t]).count();
+    return reward * owned.count() - timeSum;
+}
+
 struct Board {
     static constexpr int H = 11;
     static constexpr int W = 13;
-    Cell board[H][W];
 
+    /* boxes holds all the boxes, rangeBoxes and bombBoxes are
+     * its subsets of boxes with an item inside */
+    BitBoard walls;
+    BitBoard boxes;
+    BitBoard rangeBoxes;
+    BitBoard bombBoxes;
+
+    inline Cell at(int x, int y) const;
+    inline void set(int x, int y, Cell cell);
+    inline bool isWall(int x, int y) const;
+    inline bool isEmpty(int x, int y) const;
     inline bool isBox(int x, int y) const;
     inline bool isDrop(int x, int y) const;
     inline Item drop(int x, int y) const;
 };
 
+Cell Board::at(int x, int y) const {
+    if (walls.get(x, y))
+        return Cell::wall;
+    if (!boxes.get(x, y))
+        return Cell::empty;
+    if (rangeBoxes.get(x, y))
+        return Cell::rangeBox;
+    if (bombBoxes.get(x, y))
+        return Cell::bombBox;
+    return Cell::box;
+}
+
+void Board::set(int x, int y, Cell cell) {
+    walls.reset(x, y);
+    boxes.reset(x, y);
+    rangeBoxes.reset(x, y);
+    bombBoxes.reset(x, y);
+    switch (cell) {
+        case Cell::wall:
+            walls.set(x, y);
+            break;
+        case Cell::empty:
+            break;
+        case Cell::rangeBox:
+            rangeBoxes.set(x, y);
+            boxes.set(x, y);
+            break;
+        case Cell::bombBox:
+            bombBoxes.set(x, y);
+            boxes.set(x, y);
+            break;
+        case Cell::box:
+            boxes.set(x, y);
+            break;
+    }
+}
+
+bool Board::isWall(int x, int y) const {
+    return walls.get(x, y);
+}
+
+bool Board::isEmpty(int x, int y) const {
+    return !walls.get(x, y) && !boxes.get(x, y);
+}
+
 bool Board::isBox(int x, int y) const {
-    return board[y][x] != Cell::wall && board[y][x] != Cell::empty;
+    return boxes.get(x, y);
 }
 
 bool Board::isDrop(int x, int y) const {
-    return board[y][x] == Cell::rangeBox || board[y][x] == Cell::bombBox;
+    return rangeBoxes.get(x, y) || bombBoxes.get(x, y);
 }
 
 Item Board::drop(int x, int y) const {
-    return {x, y, board[y][x] == Cell::rangeBox ? ItemType::range : ItemType::bomb};
+    return {x, y, rangeBoxes.get(x, y) ? ItemType::range : ItemType::bomb};
 }
 
 struct ExtraInfo {
@@ -95,39 +197,73 @@ struct ExtraInfo {
     char bombsIncrease[MAX_PLAYERS] = {}; /* zero initialization */
 };
 
+struct SurvivalInfo {
+    static constexpr int NEVER = -1;
+
+    /* number of moves after which the player can stand on a cell
+     * that never explodes (or all the bombs are gone), NEVER if
+     * every path runs into an explosion */
+    int safeTick = NEVER;
+    /* cells the player can stand on after safeTick moves */
+    BitBoard safeCells;
+
+    inline bool canSurvive() const;
+};
+
+bool SurvivalInfo::canSurvive() const {
+    return safeTick != NEVER;
+}
+
 struct GameState {
     static constexpr int H = 11;
     static constexpr int W = 13;
     static constexpr int DIR_COUNT = 5;
     static constexpr int dx[DIR_COUNT] = {-1, 1, 0, 0, 0};
     static constexpr int dy[DIR_COUNT] = {0, 0, 1, -1, 0};
-    static constexpr int MAX_ACTIONS = 10;
     static constexpr int MAX_ACTION_TYPES = 2;
     static constexpr ActionType actionTypes[MAX_ACTION_TYPES] = {
         ActionType::bomb,
         ActionType::move
     };
+    static constexpr int ACTION_CODES = DIR_COUNT * MAX_ACTION_TYPES;
     static constexpr int MAX_PLAYERS = 4;
     static constexpr int MAX_BOMB_TIME = 8;
-    static int myid;
+    /* every cell except the fixed walls can hold at most one bomb or item */
+    static constexpr int MAX_FREE_CELLS = H * W - (H / 2) * (W / 2);
+    static constexpr int MAX_BOMBS = MAX_FREE_CELLS;
+    static constexpr int MAX_ITEMS = MAX_FREE_CELLS;
+    /* player the search is done for, one per thread, so that games
+     * can run in parallel, pool threads take it from their agent */
+    static thread_local int myid;
 
     Board board;
-    std::vector<Player> players;
-    std::vector<Bomb> bombs;
-    std::vector<Item> items;
+    InlineVector<Player, MAX_PLAYERS> players;
+    InlineVector<Bomb, MAX_BOMBS> bombs;
+    InlineVector<Item, MAX_ITEMS> items;
+    /* Zobrist hash of board, players, bombs and items, succ updates it */
+    hash_t hash = 0;
 
     Explosions getExplosions() const;
+    Explosions getExplosions(const GameState& prev,
+        const Explosions& prevExplosions) const;
+    void retrace(const BitBoard& stale, Explosions& explosions) const;
+    hash_t computeHash() const;
     const Player* getPlayer(int id) const;
     int countAllBombs(int id) const;
     std::optional<std::pair<GameState, ExtraInfo>> succ(const Explosions& explosions,
-        const Actions& actions) const;
-    bool validActions(const Actions& actions) const;
+        const JointAction& actions) const;
+    bool validActions(const JointAction& actions) const;
     bool canSurvive(const Explosions& explosions) const;
-    std::vector<Action> getActions() const;
-    std::set<Action> getPossibleActions() const;    
-    std::set<Action> _getPossibleActions(Actions actions) const;
+    SurvivalInfo getSurvivalInfo(const Explosions& explosions) const;
+    ActionMask getActionMask(int id) const;
+    ActionMask getSafeActions() const;
+    ActionMask _getSafeActions(const Explosions& explosions,
+        JointAction actions, ActionMask candidates) const;
 
     static inline bool isInBounds(int x, int y);
+    static inline ActionCode encode(int dir, ActionType type);
+    static inline ActionCode encode(const Action& action, int x, int y);
+    static inline Action decode(ActionCode code, int x, int y);
 
     friend std::istream& operator>>(std::istream& in, GameState& gameState);
 };
@@ -136,4 +272,29 @@ bool GameState::isInBounds(int x, int y) {
     return 0 <= x && x < W && 0 <= y && y < H;
 }
 
+ActionCode GameState::encode(int dir, ActionType type) {
+    return dir << 1 | (type == ActionType::bomb);
+}
+
+/* code of the action taken by a player standing at (x, y) */
+ActionCode GameState::encode(const Action& action, int x, int y) {
+    /* direction index by (dy + 1) * 3 + (dx + 1), -1 if not a neighbour */
+    static constexpr int dirOf[9] = {-1, 3, -1, 0, 4, 1, -1, 2, -1};
+    int ddx = action.x - x, ddy = action.y - y;
+    assert(std::abs(ddx) + std::abs(ddy) < 2);
+    int dir = dirOf[(ddy + 1) * 3 + (ddx + 1)];
+    assert(dir >= 0 && dx[dir] == ddx && dy[dir] == ddy);
+    return encode(dir, action.type);
+}
+
+Action GameState::decode(ActionCode code, int x, int y) {
+    assert(code < ACTION_CODES);
+    int dir = code >> 1;
+    return {code & 1 ? ActionType::bomb : ActionType::move,
+        x + dx[dir], y + dy[dir]};
+}
+
+static_assert(std::is_trivially_copyable_v<GameState>,
+    "GameState has to be copyable with memcpy!");
+
 #endif /* GAME_STATE_HPP */
@@ -1,124 +1,143 @@
 #include "MCTS.hpp"
 
+#include <tuple>
+#include <numeric>
+#include <thread>
+
 Node::Node()
 {
 	SIG();
 	terminal = true;
-	parent = nullptr;
+	expanding = false;
+	parent = NONE;
+	children = NONE;
+	childCount = 0;
 	visits = 1;
 	sum_score = 0;
 	this->isRoot = false;
-	this->clown_children = 0;
 }
 
-Node::Node(Node* parent)
+Node::Node(uint32_t parent)
 {
 	SIG();
 	this->terminal = true;
+	this->expanding = false;
 	this->parent = parent;
+	this->children = NONE;
+	this->childCount = 0;
 	this->visits = 1;
 	this->sum_score = 0.0;
 	this->state.score = -5.0;
 	this->isRoot = false;
 }
 
-Node::Node(State state, Node* parent, int visits, State::eval_t sum_score, bool terminal)
+Node::Node(const State& state, uint32_t parent, int visits, State::eval_t sum_score, bool terminal)
 {
 	SIG();
 	this->state = state;
+	this->expanding = false;
 	this->parent = parent;
+	this->children = NONE;
+	this->childCount = 0;
 	this->visits = visits;
 	this->sum_score = sum_score;
 
-	this->actions = *(new std::vector<Action>());
-	std::set<Action> as = state.game.getPossibleActions();
 	this->actions.clear();
-	for(auto x = as.begin(); x!= as.end(); x++)
+	for(ActionMask as = state.game.getSafeActions(); as; as &= as - 1)
     {
-    	this->actions.push_back(*x);
+    	this->actions.push_back(__builtin_ctz(as));
     }
 
-	for(const Action& a : this->actions)
-	{
-		auto p = state.game.getPlayer(state.game.myid);
-		assert(abs(p->x - a.x) + abs(p->y - a.y) < 2);
-	}
 	this->isRoot = false;
 	this->terminal = terminal;
-	this->clown_children = 0;
 }
 
 void Node::setRoot()
 {
 	this->isRoot = true;
-	std::set<Action> as = state.game.getPossibleActions();
 	this->actions.clear();
-	for(auto x = as.begin(); x!= as.end(); x++)
+	for(ActionMask as = state.game.getSafeActions(); as; as &= as - 1)
     {
-    	this->actions.push_back(*x);
+    	this->actions.push_back(__builtin_ctz(as));
     }
 }
 
-Node::~Node()
-{
-	for(size_t i=0; i<this->children.size(); i++)
-	{
-		delete this->children[i];
-	}
-}
-
 bool Node::fullyExpanded()
 {
-	int c_size = this->children.size();
-	return c_size >= int(this->actions.size());
+	return getChildCount() >= this->actions.size();
 }
 
-Node* Node::newChild(bool)
+/* self is the index of this node, pool may allocate a new block,
+ * but nodes never move, so this stays valid; in a shared tree the
+ * caller holds the lock of the node and the child becomes visible
+ * to other threads once it is complete; NONE if the pool is full */
+uint32_t Node::newChild(NodePool& pool, uint32_t self)
 {
-	Action newAction = this->actions[children.size()];
-
-	auto succState = this->state.succ({{state.game.myid, newAction}});
-
-	if(!succState)
+	if (children == NONE)
 	{
-		children.push_back(new Node(this));
-		return children[children.size() - 1];
+		children = pool.allocate(this->actions.size());
+		if (children == NONE)
+			return NONE;
 	}
 
-	State newState = succState.value();
+	auto p = state.game.getPlayer(state.game.myid);
+	assert(p);
+	Action newAction = state.game.decode(this->actions[childCount], p->x, p->y);
+
+	auto succState = this->state.succ(JointAction(state.game.myid, newAction));
+
+	uint32_t child = children + childCount;
+	if(!succState)
+		pool[child] = Node(self);
+	else
+		pool[child] = Node(succState.value(), self);
+	__atomic_store_n(&childCount, childCount + 1, __ATOMIC_RELEASE);
 
-	children.push_back(new Node(newState, this));
-	return children[children.size()-1];
+	return child;
 }
 
-void Node::updateStats(State::eval_t result)
+void Node::updateStats(State::eval_t result, int visits, bool shared)
 {
-	this->sum_score += result/10.0f;
-	this->visits += 1;
+	if (!shared)
+	{
+		this->sum_score += result/10.0f;
+		this->visits += visits;
+		return;
+	}
+
+	__atomic_fetch_add(&this->visits, visits, __ATOMIC_RELAXED);
+	State::eval_t expected = getScore(), desired;
+	do
+		desired = expected + result/10.0f;
+	while (!__atomic_compare_exchange(&sum_score, &expected, &desired,
+		true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 }
 
-float Node::UTC(const Node* child)
+float Node::UTC(const Node& child)
 {
 	float C = 1.0f;
 	float D = 1000.0f;
 
-	float Xdash = child->sum_score/child->visits;
-	float first_sqrt = sqrt(log(this->visits)/child->visits);
-	float second_sqrt = sqrt((pow(child->sum_score, 2) - child->visits * Xdash + D)/child->visits);
+	int visits = child.getVisits();
+	State::eval_t sum_score = child.getScore();
+
+	float Xdash = sum_score/visits;
+	float first_sqrt = sqrt(log(this->getVisits())/visits);
+	float second_sqrt = sqrt((pow(sum_score, 2) - visits * Xdash + D)/visits);
 
 	return Xdash + C*first_sqrt + second_sqrt;
 }
 
-Node* Node::childBestUTC()
+uint32_t Node::childBestUTC(NodePool& pool)
 {
 	float bestVal = -1000000.f;
 	int bestIt = -1;
 
-	assert(this->children.size() > 0);
-	for(size_t i = 0; i<this->children.size(); i++)
+	int childCount = getChildCount();
+	assert(childCount > 0);
+	for(int i = 0; i<childCount; i++)
 	{
-		Node* child = this->children[i];
-		float val = UTC(child);
+		float val = UTC(pool[children + i]);
 		if(val > bestVal)
 		{
 			bestVal = val;
@@ -126,21 +145,22 @@ Node* Node::childBestUTC()
 		}
 	}
 
-	// bestIt = rand() % int(children.size());
+	// bestIt = rand() % childCount;
 
 	assert(bestIt >= 0);
-	return this->children[bestIt];
+	return children + bestIt;
 }
 
-int Node::pickBestChild()
+int Node::pickBestChild(NodePool& pool)
 {
 	float bestVal = -10000000.0;
 	int bestIt = -1;
-	for(size_t i=0; i<children.size(); i++)
+	for(int i=0; i<childCount; i++)
 	{
-		if(children[i]->sum_score/children[i]->visits > bestVal && children[i]->visits>1)
+		const Node& child = pool[children + i];
+		if(child.getScore()/child.getVisits() > bestVal && child.getVisits()>1)
 		{
-			bestVal = children[i]->sum_score/children[i]->visits;
+			bestVal = child.getScore()/child.getVisits();
 			bestIt = i;
 		}
 	}
@@ -148,31 +168,57 @@ int Node::pickBestChild()
 	return bestIt;
 }
 
-int Node::pickBestUTCAction()
+int Node::pickBestUTCAction(NodePool& pool)
 {
 	float bestVal = -10000000.0;
 	int bestIt = -1;
-	for(size_t i=0; i<children.size(); i++)
+	for(int i=0; i<childCount; i++)
 	{
-		if(UTC(children[i])> bestVal)
+		if(UTC(pool[children + i])> bestVal)
 		{
-			bestVal = UTC(children[i]);
+			bestVal = UTC(pool[children + i]);
 			bestIt = i;
 		}
 	}
 	return bestIt;
 }
 
-Action Node::pickBestAction()
+Action Node::pickBestAction(NodePool& pool)
 {
-	int it = this->pickBestChild();
+	int it = this->pickBestChild(pool);
 	assert(it>=0);
-	return this->actions[it];
+	auto p = state.game.getPlayer(state.game.myid);
+	assert(p);
+	return state.game.decode(this->actions[it], p->x, p->y);
+}
+
+uint32_t NodePool::allocate(int count)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	assert(0 < count && count <= int(BLOCK_SIZE));
+	/* a run of nodes never crosses blocks */
+	uint32_t first = used;
+	if (first / BLOCK_SIZE != (first + count - 1) / BLOCK_SIZE)
+		first = (first + count - 1) / BLOCK_SIZE * BLOCK_SIZE;
+	while ((first + count - 1) / BLOCK_SIZE >= blockCount)
+	{
+		if (blockCount == MAX_BLOCKS)
+		{
+			__atomic_store_n(&full, true, __ATOMIC_RELAXED);
+			return Node::NONE;
+		}
+		blocks[blockCount++].reset(new Node[BLOCK_SIZE]);
+	}
+
+	used = first + count;
+	return first;
 }
 
 int MCTS::_allcount = 0;
 
-MCTS::MCTS() {
+MCTS::MCTS(int threads, Parallelism parallelism) :
+	threads(threads), parallelism(parallelism) {
+	assert(threads >= 1);
 	name = "MCTS";
 }
 
@@ -195,73 +241,300 @@ State MCTS::getInitialState(const GameState& game) {
     return initialState;
 }
 
-Action MCTS::getAction(const GameState& game, const int timeLimit)
+/* moves the subtree under the action picked in the previous turn to
+ * the front of a fresh pool if it still describes the observed game,
+ * that is only if the opponents did not move nor place a bomb, as the
+ * tree keeps them where they were and the states of all its nodes
+ * would plan against bombs of positions they left; the stats of the nodes stay relative to the previous root; nodes are
+ * copied in breadth first order and the ones past MAX_REUSED_NODES
+ * or MAX_REUSED_DEPTH become leaves again */
+bool MCTS::reuseTree(SearchTree& tree, const State& initialState)
+{
+	if (tree.nextRoot == Node::NONE)
+		return false;
+	uint32_t oldRoot = tree.nextRoot;
+	tree.nextRoot = Node::NONE;
+
+	NodePool& pool = tree.pool();
+	NodePool& spare = tree.spare();
+	const Node& candidate = pool[oldRoot];
+	if (candidate.terminal)
+		return false;
+	if (candidate.state.game.hash != initialState.game.hash)
+		return false;
+	/* children follow the order of actions, so those have to agree */
+	ActionMask actions = 0;
+	for (const auto& action : candidate.actions)
+		actions |= 1 << action;
+	if (actions != initialState.game.getSafeActions())
+		return false;
+
+	static_assert(MAX_REUSED_NODES * 2 <= NodePool::BLOCK_SIZE * NodePool::MAX_BLOCKS,
+		"Reused nodes have to fit into a fresh pool!");
+	spare.reset();
+	uint32_t root = spare.allocate(1);
+	spare[root] = candidate;
+	std::vector<std::tuple<uint32_t, uint32_t, int>> queue = {{oldRoot, root, 0}};
+	for (size_t i = 0; i < queue.size(); ++i)
+	{
+		auto [from, to, depth] = queue[i];
+		const Node& node = pool[from];
+		if (node.children == Node::NONE)
+			continue;
+		if (depth == MAX_REUSED_DEPTH ||
+			spare.size() + node.actions.size() > MAX_REUSED_NODES)
+		{
+			spare[to].children = Node::NONE;
+			spare[to].childCount = 0;
+			continue;
+		}
+		uint32_t children = spare.allocate(node.actions.size());
+		for (int c = 0; c < node.childCount; ++c)
+		{
+			spare[children + c] = pool[node.children + c];
+			spare[children + c].parent = to;
+			queue.push_back({node.children + c, children + c, depth + 1});
+		}
+		spare[to].children = children;
+	}
+	tree.current ^= 1;
+
+	tree.root = root;
+	spare[root].state = initialState;
+	spare[root].parent = Node::NONE;
+	return true;
+}
+
+/* sets the root of the tree for this turn, returns the number of
+ * nodes reused from the previous turn */
+int MCTS::prepareTree(SearchTree& tree, const State& initialState)
 {
+	bool reused = reuseTree(tree, initialState);
+	NodePool& pool = tree.pool();
+	if (!reused)
+	{
+		pool.reset();
+		tree.root = pool.allocate(1);
+		pool[tree.root] = Node(initialState, Node::NONE);
+	}
+	pool[tree.root].setRoot();
+	return reused ? pool.size() : 0;
+}
+
+Action MCTS::getAction(const GameState& game, const Budget& budget)
+{
+	BENCH();
+	Timer timer(budget);
 	State::evalFunction = eval;
+	table.newTurn();
 
 	this->k_deep = 8;
-	Node node = Node(this->getInitialState(game), nullptr);
-	node.setRoot();
+	auto initialState = this->getInitialState(game);
+
+	int treeCount = parallelism == Parallelism::root ? threads : 1;
+	while (int(trees.size()) < treeCount)
+		trees.emplace_back(new SearchTree());
+	if (threads > 1 && !threadPool)
+		threadPool.reset(new ThreadPool(threads));
+
+	std::vector<int> iterations(threads), reusedSizes(treeCount);
+	if (threads == 1)
+	{
+		reusedSizes[0] = prepareTree(*trees[0], initialState);
+		iterations[0] = search(*trees[0], timer, false);
+	}
+	else if (parallelism == Parallelism::root)
+		threadPool->run(threads, [&](int i){
+			State::evalFunction = eval;
+			GameState::myid = myid;
+			reusedSizes[i] = prepareTree(*trees[i], initialState);
+			iterations[i] = search(*trees[i], timer, false);
+		});
+	else
+	{
+		reusedSizes[0] = prepareTree(*trees[0], initialState);
+		threadPool->run(threads, [&](int i){
+			State::evalFunction = eval;
+			GameState::myid = myid;
+			iterations[i] = search(*trees[0], timer, true);
+		});
+	}
+
+	if (verbose) {
+		int treeSize = 0;
+		for (int i = 0; i < treeCount; ++i)
+			treeSize += trees[i]->pool().size();
+		std::cerr << "Iterations done: " << std::accumulate(all(iterations), 0) << std::endl;
+		std::cerr << "Tree size: " << treeSize << std::endl;
+		std::cerr << "Reused nodes: " << std::accumulate(all(reusedSizes), 0) << std::endl;
+	}
+
+	ActionCode best = pickBestAction();
+
+	/* keep the subtree of the picked action for the next turn */
+	for (int i = 0; i < treeCount; ++i)
+	{
+		SearchTree& tree = *trees[i];
+		const Node& root = tree.pool()[tree.root];
+		tree.nextRoot = Node::NONE;
+		for (int c = 0; c < root.childCount; ++c)
+			if (root.actions[c] == best)
+				tree.nextRoot = root.children + c;
+	}
 
-	auto t1 = std::chrono::high_resolution_clock::now();
-	auto t2 = std::chrono::high_resolution_clock::now();
+	auto me = game.getPlayer(myid);
+	assert(me);
+	return game.decode(best, me->x, me->y);
+}
 
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>( t2 - t1 ).count();
+int MCTS::search(SearchTree& tree, const Timer& timer, bool shared)
+{
+	NodePool& pool = tree.pool();
 
 	int _count = 0;
-	while(duration < timeLimit)
+	while(timer.spend())
 	{
-		assert(!node.parent);
-		assert(node.isRoot);
-		
-        Node* leaf = this->traverse(&node);
+		assert(pool[tree.root].parent == Node::NONE);
+		assert(pool[tree.root].isRoot);
+
+		uint32_t leaf = this->traverse(tree, tree.root, shared);
 		State::eval_t result;
-		if(!leaf->terminal)
-			result = this->rollout(leaf);
+		if(!pool[leaf].terminal)
+			result = this->rollout(tree, leaf);
 		else
 			result = death_reward;
 
-		this->backpropagate(leaf, result);
-		t2 = std::chrono::high_resolution_clock::now();
-		duration = std::chrono::duration_cast<std::chrono::milliseconds>( t2 - t1 ).count();
+		this->backpropagate(tree, leaf, result, shared);
 		_count++;
 	}
 
-	return node.pickBestAction();
+	return _count;
 }
 
-Node* MCTS::traverse(Node* node)
+/* best action by the average score of its children over all the
+ * trees, ignoring children without any visit but the initial one */
+ActionCode MCTS::pickBestAction()
 {
-	Node* curNode = node;
-	while(curNode->fullyExpanded() && !curNode->terminal)
+	int treeCount = parallelism == Parallelism::root ? threads : 1;
+	int visits[GameState::ACTION_CODES] = {};
+	int created[GameState::ACTION_CODES] = {};
+	State::eval_t scores[GameState::ACTION_CODES] = {};
+
+	for (int i = 0; i < treeCount; ++i)
 	{
-		curNode = curNode->childBestUTC();
+		NodePool& pool = trees[i]->pool();
+		const Node& root = pool[trees[i]->root];
+		for (int c = 0; c < root.childCount; ++c)
+		{
+			const Node& child = pool[root.children + c];
+			visits[root.actions[c]] += child.visits;
+			scores[root.actions[c]] += child.sum_score;
+			++created[root.actions[c]];
+		}
 	}
-	if(curNode->terminal)
-		return curNode;
-	else
-		return curNode->newChild(false);
+
+	/* with very little time no child may have been visited again,
+	 * then the single visits decide */
+	int best = -1;
+	for (int minVisits : {1, 0})
+	{
+		float bestVal = -10000000.0;
+		for (int code = 0; code < GameState::ACTION_CODES; ++code)
+			if (visits[code] > created[code] * minVisits && scores[code]/visits[code] > bestVal)
+			{
+				bestVal = scores[code]/visits[code];
+				best = code;
+			}
+		if (best >= 0)
+			return best;
+	}
+
+	return trees[0]->pool()[trees[0]->root].actions[0];
 }
 
-State::eval_t MCTS::rollout(Node* node)
+/* in a shared tree every node on the path gets a virtual loss - a visit
+ * that counts as a death until the rollout ends, so that the other
+ * threads are steered away from it */
+uint32_t MCTS::traverse(SearchTree& tree, uint32_t node, bool shared)
 {
-	State curState = node->state;
+	NodePool& pool = tree.pool();
+	uint32_t curNode = node;
+	while(!pool[curNode].terminal)
+	{
+		Node& cur = pool[curNode];
+		if(!cur.fullyExpanded() && !pool.isFull())
+		{
+			if(!shared)
+			{
+				uint32_t child = cur.newChild(pool, curNode);
+				if(child != Node::NONE)
+					return child;
+				continue;
+			}
+
+			if(cur.tryLock())
+			{
+				uint32_t child = Node::NONE;
+				if(!cur.fullyExpanded())
+					child = cur.newChild(pool, curNode);
+				cur.unlock();
+				if(child != Node::NONE)
+				{
+					pool[child].updateStats(death_reward, 1, true);
+					return child;
+				}
+				continue;
+			}
+
+			/* another thread expands it, go down the children it has */
+			if(cur.getChildCount() == 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+		}
+
+		/* the pool is full, the tree stops growing and the
+		 * playout starts from a node without children */
+		if(cur.getChildCount() == 0)
+			return curNode;
 
+		curNode = cur.childBestUTC(pool);
+		if(shared)
+			pool[curNode].updateStats(death_reward, 1, true);
+	}
+	return curNode;
+}
+
+State::eval_t MCTS::rollout(SearchTree& tree, uint32_t node)
+{
+	BENCH();
+	const State& state = tree.pool()[node].state;
+
+	TranspositionTable::Entry entry;
+	bool found = table.probe(state.hash, entry);
+	if(found && entry.visits >= TABLE_ROLLOUTS)
+		return entry.evaluation;
+
+	State::eval_t result = this->randomPlayout(state);
+	if(!found)
+		entry = TranspositionTable::Entry();
+	entry.evaluation = (entry.evaluation * entry.visits + result) / (entry.visits + 1);
+	entry.visits += 1;
+	table.store(state.hash, entry);
+
+	return result;
+}
+
+State::eval_t MCTS::randomPlayout(State curState)
+{
 	int k = 0;
 
 	while(k < this->k_deep)
 	{
         Action a = curState.getRandomAction();
-        int c = 0;
-        while(!curState.game.validActions({{curState.game.myid, a}}))
-        {
-        	a = curState.getRandomAction();
-        	c++;
-        	if(c >= 8)
-        		return death_reward;
-        }
-
-		auto succState = curState.succ({{node->state.game.myid,a}});
+
+		auto succState = curState.succ(JointAction(curState.game.myid, a));
 		if(!succState)
 			return death_reward;
 		curState = succState.value();
@@ -285,10 +558,7 @@ State::eval_t MCTS::eval(const State& s) {
     points += 6.5 * std::min(3, s.myBombs) + 3.1 * std::min(4, s.myBombs) + 1.5 * s.myBombs;
     points -= 0.2 * (s.myBombs - me->bombs);
 
-    for (int y = 0; y < s.game.H; ++y)
-        for (int x = 0; x < s.game.W; ++x)
-            if (s.game.board.isBox(x, y) && s.explosions.isOwner(x, y, s.game.myid))
-                points += boxReward - s.explosions.e[y][x].time;
+    points += s.explosions.ownedReward(s.game.board.boxes, s.game.myid, boxReward);
             
     points -= 0.04 * std::abs(me->x - s.game.W * 0.5);
     points -= 0.04 * std::abs(me->y - s.game.H * 0.5);
@@ -296,20 +566,25 @@ State::eval_t MCTS::eval(const State& s) {
     return points;
 }
 
-void MCTS::backpropagate(Node* node, State::eval_t result)
+void MCTS::backpropagate(SearchTree& tree, uint32_t node, State::eval_t result, bool shared)
 {
-	assert(node);
+	NodePool& pool = tree.pool();
+	assert(node != Node::NONE);
 	int k = 0;
-	while(node)
+	while(node != Node::NONE)
 	{
-		if(node->isRoot)
+		if(pool[node].isRoot)
 		{
-			node->visits += 1;
+			pool[node].updateStats(0, 1, shared);
 			return;
 		}
-		node->updateStats(result);
+		/* the visit was already counted with the virtual loss */
+		if(shared)
+			pool[node].updateStats(result - death_reward, 0, true);
+		else
+			pool[node].updateStats(result);
 		k++;
-		if(node->parent)
-			node = node->parent;
+		if(pool[node].parent != Node::NONE)
+			node = pool[node].parent;
 	}
 }
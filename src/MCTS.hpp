@@ -6,62 +6,215 @@
 #include "GameState.hpp"
 #include "Common.hpp"
 #include "State.hpp"
+#include "ThreadPool.hpp"
+#include "TranspositionTable.hpp"
+
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+class NodePool;
 
 class Node
 {
 public:
-	bool terminal;
-	int clown_children;
+	static constexpr uint32_t NONE = UINT32_MAX;
 
-	Node *parent;
-	State state;
+	bool terminal;
 	bool isRoot;
-	std::vector<Node*> children;
+	/* taken by the thread expanding the node in a shared tree */
+	bool expanding;
+
+	/* indices into the NodePool, children are allocated
+	 * contiguously starting from children */
+	uint32_t parent;
+	uint32_t children;
+	int childCount;
+
 	int visits;
 	State::eval_t sum_score;
+	State state;
 
-	std::vector<Action> actions;
+	InlineVector<ActionCode, GameState::ACTION_CODES> actions;
 
 	Node();
-	Node(Node* parent);
-	Node(State state, Node* parent, int visits = 1, State::eval_t sum_score = 0.f, bool terminal = false);
-	~Node();
+	Node(uint32_t parent);
+	Node(const State& state, uint32_t parent, int visits = 1, State::eval_t sum_score = 0.f, bool terminal = false);
 
 	bool fullyExpanded();
 
-	Node* newChild(bool dbg = false);
+	uint32_t newChild(NodePool& pool, uint32_t self);
 
 	void setRoot();
-	void updateStats(State::eval_t result);
+	void updateStats(State::eval_t result, int visits = 1, bool shared = false);
+
+	/* stats and children are read atomically, so that other
+	 * threads may update them in a shared tree */
+	inline int getVisits() const;
+	inline State::eval_t getScore() const;
+	inline int getChildCount() const;
+	inline bool tryLock();
+	inline void unlock();
+
+	float UTC(const Node& node);
+
+	uint32_t childBestUTC(NodePool& pool);
+	int pickBestChild(NodePool& pool);
+	int pickBestUTCAction(NodePool& pool);
+	Action pickBestAction(NodePool& pool);
+};
 
-	float UTC(const Node* node);
+int Node::getVisits() const
+{
+	return __atomic_load_n(&visits, __ATOMIC_RELAXED);
+}
 
-	Node* childBestUTC();
-	int pickBestChild();
-	int pickBestUTCAction();
-	Action pickBestAction();
+State::eval_t Node::getScore() const
+{
+	State::eval_t score;
+	__atomic_load(&sum_score, &score, __ATOMIC_RELAXED);
+	return score;
+}
+
+int Node::getChildCount() const
+{
+	return __atomic_load_n(&childCount, __ATOMIC_ACQUIRE);
+}
+
+bool Node::tryLock()
+{
+	return !__atomic_test_and_set(&expanding, __ATOMIC_ACQUIRE);
+}
+
+void Node::unlock()
+{
+	__atomic_clear(&expanding, __ATOMIC_RELEASE);
+}
+
+/* bump allocator of nodes, memory is kept in fixed size blocks
+ * so that nodes never move, reset frees all of them at once;
+ * allocation is thread safe, nodes are read without locking;
+ * past MAX_BLOCKS blocks allocation fails with Node::NONE and
+ * the pool stays full until the next reset */
+class NodePool
+{
+public:
+	static constexpr uint32_t BLOCK_SIZE = 1 << 11;
+	/* bytes of nodes one pool may hold, blocks are kept over resets;
+	 * a tree has two pools and root parallelism a tree per thread,
+	 * so an agent takes up to 2 * threads times that */
+	static constexpr size_t MEMORY_BUDGET = size_t(64) << 20;
+	static constexpr uint32_t MAX_BLOCKS = MEMORY_BUDGET / (BLOCK_SIZE * sizeof(Node));
+	static_assert(MAX_BLOCKS >= 1, "Memory budget has to fit a block!");
+
+	inline Node& operator[](uint32_t index);
+	uint32_t allocate(int count);
+	inline void reset();
+	inline uint32_t size() const;
+	inline bool isFull() const;
+
+private:
+	std::unique_ptr<Node[]> blocks[MAX_BLOCKS];
+	uint32_t blockCount = 0;
+	uint32_t used = 0;
+	bool full = false;
+	std::mutex mutex;
 };
 
+Node& NodePool::operator[](uint32_t index)
+{
+	return blocks[index / BLOCK_SIZE][index % BLOCK_SIZE];
+}
+
+void NodePool::reset()
+{
+	used = 0;
+	full = false;
+}
+
+uint32_t NodePool::size() const
+{
+	return used;
+}
+
+bool NodePool::isFull() const
+{
+	return __atomic_load_n(&full, __ATOMIC_RELAXED);
+}
+
+/* the tree lives in one of the pools, the other one
+ * receives the subtree reused in the next turn */
+struct SearchTree
+{
+	NodePool pools[2];
+	int current = 0;
+	uint32_t root = Node::NONE;
+	/* child of the root picked in the previous turn */
+	uint32_t nextRoot = Node::NONE;
+
+	inline NodePool& pool();
+	inline NodePool& spare();
+};
+
+NodePool& SearchTree::pool()
+{
+	return pools[current];
+}
+
+NodePool& SearchTree::spare()
+{
+	return pools[current ^ 1];
+}
+
 class MCTS : public Agent
 {
 public:
-	Node* root;
+	/* root - every thread searches its own tree, the trees are merged
+	 * when picking the action; tree - all threads search one tree */
+	enum class Parallelism { root, tree };
+
 	int k_deep;
 
 	float death_reward = -5.0f;
 
+	/* bound the memory of a tree kept over many turns and the length
+	 * of its paths, UTC prefers visited children, so the tree grows
+	 * deep and every selection would walk all of it */
+	static constexpr uint32_t MAX_REUSED_NODES = 1 << 14;
+	static constexpr int MAX_REUSED_DEPTH = 16;
+	/* rollouts from a state after which their mean stands in for
+	 * new ones, the same state is reached by many orders of moves */
+	static constexpr int TABLE_ROLLOUTS = 4;
+
 	static int _allcount;
 
-	MCTS();
+	MCTS(int threads = 1, Parallelism parallelism = Parallelism::tree);
 
 	State getInitialState(const GameState& game);
 
-	Action getAction(const GameState& game, const int timeLimit) override;
-	Node* traverse(Node* node);
-	State::eval_t rollout(Node* node);
-	void backpropagate(Node* node, State::eval_t result);
+	Action getAction(const GameState& game, const Budget& budget) override;
+	int prepareTree(SearchTree& tree, const State& initialState);
+	bool reuseTree(SearchTree& tree, const State& initialState);
+	int search(SearchTree& tree, const Timer& timer, bool shared);
+	uint32_t traverse(SearchTree& tree, uint32_t node, bool shared);
+	State::eval_t rollout(SearchTree& tree, uint32_t node);
+	State::eval_t randomPlayout(State state);
+	void backpropagate(SearchTree& tree, uint32_t node, State::eval_t result, bool shared);
+	ActionCode pickBestAction();
 
 	static State::eval_t eval(const State& state);
+
+private:
+	int threads;
+	Parallelism parallelism;
+	std::unique_ptr<ThreadPool> threadPool;
+	std::vector<std::unique_ptr<SearchTree>> trees;
+	/* means of the rollouts by the state, shared by all the trees
+	 * and threads, kept over turns, so a state reached again in a
+	 * later turn starts from its earlier rollouts */
+	TranspositionTable table;
 };
 
 #endif /* MCTS_HPP */
@@ -38,6 +38,7 @@ void Manager::run() {
         auto end = std::chrono::high_resolution_clock::now();
         
         firstRound = false;
+        PROFILE_REPORT("the turn");
 
         double passed = std::chrono::duration<double>(end - start).count();
         std::cerr << "time elapsed: " << passed * 1000 << "ms" << std::endl;
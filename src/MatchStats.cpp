@@ -0,0 +1,172 @@
+#include "MatchStats.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+    constexpr float PRIOR = 0.5f;
+    constexpr float Z95 = 1.96f;
+    constexpr float EPS = 1e-4f;
+}
+
+MatchStats::MatchStats(const std::vector<std::string>& names,
+                       const std::optional<SPRT>& sprt)
+    : names(names), sprt(sprt), points(names.size(), 0.f),
+      records(names.size(), std::vector<Record>(names.size())),
+      verdicts(names.size(), Verdict::undecided) {
+    assert(2 <= names.size() && names.size() <= 4);
+    assert(!sprt || sprt->elo0 < sprt->elo1);
+}
+
+void MatchStats::addGame(const std::vector<std::string>& winners) {
+    int N = names.size();
+    std::vector<bool> won(N, false);
+    for (const auto& winner : winners) {
+        auto it = std::find(names.begin(), names.end(), winner);
+        assert(it != names.end());
+        won[it - names.begin()] = true;
+        points[it - names.begin()] += 1.f / winners.size();
+    }
+    ++played;
+
+    for (int a = 0; a < N; ++a)
+        for (int b = a + 1; b < N; ++b) {
+            auto& record = records[a][b];
+            if (won[a] == won[b])
+                ++record.draws;
+            else if (won[a])
+                ++record.wins;
+            else
+                ++record.losses;
+        }
+
+    if (!sprt)
+        return;
+
+    float lower = std::log(sprt->beta / (1 - sprt->alpha));
+    float upper = std::log((1 - sprt->beta) / sprt->alpha);
+    for (int b = 1; b < N; ++b)
+        if (verdicts[b] == Verdict::undecided) {
+            float ratio = llr(b);
+            if (ratio >= upper)
+                verdicts[b] = Verdict::accepted;
+            else if (ratio <= lower)
+                verdicts[b] = Verdict::rejected;
+        }
+}
+
+int MatchStats::games() const {
+    return played;
+}
+
+bool MatchStats::decided() const {
+    if (!sprt)
+        return false;
+    return std::all_of(verdicts.begin() + 1, verdicts.end(),
+        [](Verdict verdict){ return verdict != Verdict::undecided; });
+}
+
+MatchStats::Interval MatchStats::elo(int a, int b) const {
+    assert(a != b);
+    if (a > b) {
+        auto interval = elo(b, a);
+        return {-interval.elo, -interval.upper, -interval.lower};
+    }
+
+    const auto& record = records[a][b];
+    float score = record.score();
+    float error = Z95 * std::sqrt(record.variance() / record.total());
+    return {eloOf(score), eloOf(score - error), eloOf(score + error)};
+}
+
+/* normal approximation of the generalized SPRT,
+ * as used by engine testing frameworks */
+float MatchStats::llr(int b) const {
+    assert(sprt && 0 < b);
+    const auto& record = records[0][b];
+    float s0 = expectedScore(sprt->elo0);
+    float s1 = expectedScore(sprt->elo1);
+    return record.total() * (s1 - s0) * (2 * record.score() - s0 - s1)
+        / (2 * record.variance());
+}
+
+MatchStats::Verdict MatchStats::verdict(int b) const {
+    return verdicts[b];
+}
+
+void MatchStats::print(std::ostream& out) const {
+    int N = names.size();
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::setprecision(1) << std::fixed;
+
+    out << "\nWinrates after " << played << " games:\n"
+        << std::string(25, '-') << std::endl;
+    for (int i = 0; i < N; ++i)
+        out << names[i] << ": " << points[i] / std::max(played, 1) * 100
+            << "%" << std::endl;
+
+    out << "\nElo (95% confidence):\n" << std::string(25, '-') << std::endl;
+    for (int a = 0; a < N; ++a)
+        for (int b = a + 1; b < N; ++b) {
+            const auto& record = records[a][b];
+            auto interval = elo(a, b);
+            out << vs(a, b) << ": " << std::showpos << interval.elo
+                << " [" << interval.lower << ", " << interval.upper << "]"
+                << std::noshowpos << " (+" << record.wins << " ="
+                << record.draws << " -" << record.losses << ")" << std::endl;
+        }
+
+    if (sprt) {
+        float lower = std::log(sprt->beta / (1 - sprt->alpha));
+        float upper = std::log((1 - sprt->beta) / sprt->alpha);
+        out << "\nSPRT elo0 " << sprt->elo0 << ", elo1 " << sprt->elo1
+            << std::setprecision(2) << ", alpha " << sprt->alpha
+            << ", beta " << sprt->beta << ":\n"
+            << std::string(25, '-') << std::endl;
+        for (int b = 1; b < N; ++b) {
+            out << vs(0, b) << ": LLR " << llr(b)
+                << " [" << lower << ", " << upper << "] ";
+            if (verdicts[b] == Verdict::accepted)
+                out << "H1 accepted";
+            else if (verdicts[b] == Verdict::rejected)
+                out << "H0 accepted";
+            else
+                out << "undecided";
+            out << std::endl;
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+float MatchStats::Record::score() const {
+    return (wins + PRIOR + (draws + PRIOR) / 2) / total();
+}
+
+float MatchStats::Record::variance() const {
+    float s = score();
+    return ((wins + PRIOR) * (1 - s) * (1 - s) +
+            (draws + PRIOR) * (0.5f - s) * (0.5f - s) +
+            (losses + PRIOR) * s * s) / total();
+}
+
+float MatchStats::Record::total() const {
+    return wins + draws + losses + 3 * PRIOR;
+}
+
+float MatchStats::expectedScore(float elo) {
+    return 1 / (1 + std::pow(10.f, -elo / 400));
+}
+
+float MatchStats::eloOf(float score) {
+    score = std::clamp(score, EPS, 1 - EPS);
+    return 400 * std::log10(score / (1 - score));
+}
+
+std::string MatchStats::vs(int a, int b) const {
+    return names[a] + " vs " + names[b];
+}
@@ -0,0 +1,77 @@
+#ifndef MATCH_STATS_HPP
+#define MATCH_STATS_HPP
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <ostream>
+
+/* results of a match between 2 to 4 agents, every game is split into
+ * pairwise results - a winner beats a loser, two winners or two losers
+ * draw; the first agent is the one tested against all the others */
+class MatchStats {
+public:
+    /* sequential probability ratio test of H0: elo = elo0 against
+     * H1: elo = elo1 with false positive and false negative rates */
+    struct SPRT {
+        float elo0 = 0.f;
+        float elo1 = 50.f;
+        float alpha = 0.05f;
+        float beta = 0.05f;
+    };
+
+    enum class Verdict { undecided, accepted, rejected };
+
+    struct Interval {
+        float elo;
+        float lower;
+        float upper;
+    };
+
+    MatchStats(const std::vector<std::string>& names,
+               const std::optional<SPRT>& sprt = std::nullopt);
+
+    void addGame(const std::vector<std::string>& winners);
+
+    int games() const;
+    /* all the tests of the first agent have a verdict */
+    bool decided() const;
+
+    /* elo of a over b with 95% confidence interval */
+    Interval elo(int a, int b) const;
+    /* log likelihood ratio of H1 to H0 for the first agent against b */
+    float llr(int b) const;
+    Verdict verdict(int b) const;
+
+    void print(std::ostream& out) const;
+
+private:
+    struct Record {
+        int wins = 0;
+        int draws = 0;
+        int losses = 0;
+
+        /* score and its variance per game, the counts start from
+         * half a win, a draw and a loss, so that the variance
+         * of a one-sided match is not zero */
+        float score() const;
+        float variance() const;
+        float total() const;
+    };
+
+    static float expectedScore(float elo);
+    static float eloOf(float score);
+
+    std::string vs(int a, int b) const;
+
+    std::vector<std::string> names;
+    std::optional<SPRT> sprt;
+    int played = 0;
+    std::vector<float> points;
+    /* records[a][b] from the point of view of a, for a < b */
+    std::vector<std::vector<Record>> records;
+    /* once reached verdicts are final, the test is sequential */
+    std::vector<Verdict> verdicts;
+};
+
+#endif /* MATCH_STATS_HPP */
@@ -11,16 +11,16 @@ using Gene = RHEA::Gene;
 using Chromosome = RHEA::Chromosome;
 using eval_t = RHEA::eval_t;
 
-RHEA::RHEA() {
+RHEA::RHEA(int threads, Selection selection) :
+    threadPool(new ThreadPool(threads)), prefixCaches(threads),
+    selection(selection) {
     name = "RHEA";
 
-    possibleGenes.clear();
-    for (const auto& actionType : GameState::actionTypes)
-        for (int i = 0; i < GameState::DIR_COUNT; ++i) {
-            Gene possibleGene = {actionType, GameState::dx[i], GameState::dy[i]};
-            possibleGenes.insert(possibleGene);
-            possibleGenesVec.push_back(possibleGene);
-        }
+    possibleGenes = 0;
+    for (Gene possibleGene = 0; possibleGene < GameState::ACTION_CODES; ++possibleGene) {
+        possibleGenes |= 1 << possibleGene;
+        possibleGenesVec.push_back(possibleGene);
+    }
 
     setInitialPopulation();
 }
@@ -39,56 +39,54 @@ Chromosome RHEA::getRandomChromosome() const {
 }
 
 Gene RHEA::getRandomPossibleGene() const {
-    assert(!possibleGenes.empty());
+    assert(possibleGenes);
     return possibleGenesVec[Random::rand(possibleGenesVec.size())];
 }
 
 Gene RHEA::getRandomGene() const {
-    int actionTypeVar = Random::rand(GameState::MAX_ACTION_TYPES);
-    int dirVar = Random::rand(GameState::DIR_COUNT);
-    return {actionTypeVar == 0 ? ActionType::move : ActionType::bomb,
-        GameState::dx[dirVar], GameState::dy[dirVar]};
+    return Random::rand(GameState::ACTION_CODES);
 }
 
 Action RHEA::getAction(const GameState& game,
-                       const int timeLimit) {
-    Timer timer(timeLimit);
+                       const Budget& budget) {
+    BENCH();
+    Timer timer(budget);
     State::evalFunction = eval;
 
     this->game = &game;
+    initialState = State::getInitialState(game);
+    previousTurn = turn;
+    ++turn;
 
     /* setting possible first genes */
-    auto possibleActions = game.getPossibleActions();
-    auto me = game.getPlayer(myid);
-    assert(me);
-
-    possibleGenes.clear();
+    possibleGenes = game.getSafeActions();
     possibleGenesVec.clear();
-    for (const auto& possibleAction : possibleActions) {
-        Gene possibleGene = {possibleAction.type,
-            possibleAction.x - me->x, possibleAction.y - me->y};
-        possibleGenes.insert(possibleGene);
-        possibleGenesVec.push_back(possibleGene);
-    }
+    for (ActionMask genes = possibleGenes; genes; genes &= genes - 1)
+        possibleGenesVec.push_back(__builtin_ctz(genes));
 
-    // for (const auto& possibleAction : possibleActions)
-        // std::cerr << "possibleAction: " << possibleAction << std::endl;
+    // for (const auto& possibleGene : possibleGenesVec)
+        // std::cerr << "possibleGene: " << int(possibleGene) << std::endl;
 
-    for (auto& chromosome : population.chromosomes) {
-        auto action = getActionFromGene(me, chromosome.genes[0]);
-        if (!possibleActions.count(action))
+    for (auto& chromosome : population.chromosomes)
+        if (!(possibleGenes >> chromosome.genes[0] & 1))
             chromosome.genes[0] = getRandomPossibleGene();
-    }
 
+    /* chromosomes were sorted by the evaluations of the previous turn */
     evaluatePopulation(population);
+    std::sort(population.chromosomes,
+        population.chromosomes + population.SIZE,
+        [](const Chromosome& c1, const Chromosome& c2){
+            return c1.evaluation > c2.evaluation;
+        });
 
     int generation;
-    for (generation = 0; timer.isTimeLeft(); ++generation) {
+    for (generation = 0; timer.spend(); ++generation) {
         BENCH();
         /* it should be already evaluated */
         // for (const auto& chromosome : population.chromosomes)
             // assert(chromosome.evaluation == evaluateChromosome(chromosome));
         calculateFitness();
+        prepareSelection();
         if (!timer.isTimeLeft())
             break;
         generateChildren();
@@ -96,16 +94,18 @@ Action RHEA::getAction(const GameState& game,
             break;
         replacePopulation();
     }
+    generations = generation;
 
     auto bestAction = getBestAction();
-    assert(possibleGenes.count({bestAction.type, bestAction.x - me->x, bestAction.y - me->y}));
+    assert(possibleGenes >> game.encode(bestAction,
+        game.getPlayer(myid)->x, game.getPlayer(myid)->y) & 1);
 
     /* logging */
     if (verbose) {
         std::cerr << "Generations done: " << generation << std::endl;
         std::cerr << "Population diveristy: " << getDiversity(population) << std::endl;
 
-        auto succInfo = game.succ(game.getExplosions(), {{myid, bestAction}});
+        auto succInfo = game.succ(game.getExplosions(), JointAction(myid, bestAction));
         assert(succInfo);
         const auto& nextGame = succInfo.value().first;
         std::cerr << "Can survive: " << nextGame.canSurvive(nextGame.getExplosions()) << std::endl;
@@ -116,23 +116,35 @@ Action RHEA::getAction(const GameState& game,
         std::cerr << std::endl;
     }
 
+    playedGene = game.encode(bestAction,
+        game.getPlayer(myid)->x, game.getPlayer(myid)->y);
     advanceHorizon();
     
     return bestAction;
 }
 
-eval_t RHEA::evaluateChromosome(const Chromosome& chromosome) const {
+eval_t RHEA::evaluateChromosome(const Chromosome& chromosome,
+                                PrefixCache& cache) const {
     assert(game);
-    auto state = State::getInitialState(*game);
-    int canSurvive = -1;
-    int actionsDone = 0;
+    cache.prepare(turn, previousTurn, playedGene, initialState);
+
+    int depth = 0;
+    uint32_t node = PrefixCache::ROOT;
+    for (uint32_t next; depth < HORIZON_LENGTH &&
+        (next = cache.child(node, chromosome.genes[depth])) != PrefixCache::NONE; ++depth)
+        node = next;
 
-    for (const auto& gene : chromosome.genes) {
+    State state = cache[node].state;
+    int canSurvive = cache[node].canSurvive;
+    int actionsDone = cache[node].actionsDone;
+
+    for (; depth < HORIZON_LENGTH; ++depth) {
+        const auto& gene = chromosome.genes[depth];
         auto me = state.game.getPlayer(myid);
         assert(me);
 
         auto action = getActionFromGene(me, gene);
-        auto succInfo = state.succ({{myid, action}});
+        auto succInfo = state.succ(JointAction(myid, action));
 
         if (succInfo) {
             state = succInfo.value();
@@ -140,6 +152,17 @@ eval_t RHEA::evaluateChromosome(const Chromosome& chromosome) const {
             if (canSurvive == -1 && !state.canSurvive())
                 canSurvive = actionsDone;
         }
+
+        /* whole chromosomes rarely repeat, only proper prefixes are kept */
+        if (depth + 1 == HORIZON_LENGTH)
+            break;
+        if (node != PrefixCache::NONE)
+            node = cache.addChild(node, gene);
+        if (node != PrefixCache::NONE) {
+            cache[node].state = state;
+            cache[node].canSurvive = canSurvive;
+            cache[node].actionsDone = actionsDone;
+        }
     }
 
     eval_t punishment = canSurvive == -1 ?
@@ -148,8 +171,111 @@ eval_t RHEA::evaluateChromosome(const Chromosome& chromosome) const {
     return state.score - 10 * punishment;
 }
 
+void RHEA::PrefixCache::prepare(unsigned long turn, unsigned long previousTurn,
+                                Gene gene, const State& initialState) {
+    if (this->turn == turn)
+        return;
+    bool rerooted = this->turn == previousTurn && reroot(gene, initialState);
+    this->turn = turn;
+    if (rerooted)
+        return;
+
+    prefixes.reserve(MAX_PREFIXES);
+    prefixes.resize(1);
+    prefixes[ROOT].state = initialState;
+    prefixes[ROOT].actionsDone = 0;
+    prefixes[ROOT].canSurvive = -1;
+    clear();
+}
+
+void RHEA::PrefixCache::clear() {
+    prefixes.resize(1);
+    std::fill_n(prefixes[ROOT].children, GameState::ACTION_CODES, NONE);
+}
+
+/* children are created after their parents, so moving the kept
+ * prefixes in the order of their indices moves every one of them
+ * to an index no greater than its own, nothing is overwritten;
+ * states are rebased to count boxes and actions from the new root */
+bool RHEA::PrefixCache::reroot(Gene gene, const State& initialState) {
+    if (prefixes.empty())
+        return false;
+    uint32_t target = child(ROOT, gene);
+    if (target == NONE)
+        return false;
+    const Prefix& played = prefixes[target];
+    if (played.actionsDone != 1 || played.canSurvive != -1 ||
+        played.state.game.hash != initialState.game.hash ||
+        played.state.myRange != initialState.myRange ||
+        played.state.myBombs != initialState.myBombs)
+        return false;
+    const State base = played.state;
+
+    std::vector<uint32_t> index(prefixes.size(), NONE);
+    uint32_t count = 0;
+    index[target] = 0;
+    for (uint32_t node = target; node < prefixes.size(); ++node) {
+        if (index[node] == NONE)
+            continue;
+        index[node] = count++;
+        for (uint32_t c : prefixes[node].children)
+            if (c != NONE)
+                index[c] = 0;
+    }
+
+    for (uint32_t node = target; node < prefixes.size(); ++node) {
+        if (index[node] == NONE)
+            continue;
+        Prefix& prefix = prefixes[node];
+        State& state = prefix.state;
+        int actionsDone = prefix.actionsDone - 1;
+
+        if (node == target || actionsDone == 0)
+            state = initialState;
+        else {
+            /* firstAction is set when its parent is moved */
+            state.firstLayer = false;
+            state.boxSum -= base.boxSum + actionsDone * base.boxAdd;
+            state.boxAdd -= base.boxAdd;
+            state.score = State::evalFunction(state);
+            state.hash = state.getHash();
+        }
+        prefix.actionsDone = actionsDone;
+        if (prefix.canSurvive != -1)
+            --prefix.canSurvive;
+
+        for (Gene g = 0; g < GameState::ACTION_CODES; ++g) {
+            uint32_t& c = prefix.children[g];
+            if (c == NONE)
+                continue;
+            prefixes[c].state.firstAction = actionsDone == 0 ? g : state.firstAction;
+            c = index[c];
+        }
+        prefixes[index[node]] = prefix;
+    }
+    prefixes.resize(count);
+    return true;
+}
+
+uint32_t RHEA::PrefixCache::addChild(uint32_t node, Gene gene) {
+    if (int(prefixes.size()) == MAX_PREFIXES) {
+        clear();
+        return NONE;
+    }
+
+    uint32_t child = prefixes.size();
+    prefixes.emplace_back();
+    std::fill_n(prefixes[child].children, GameState::ACTION_CODES, NONE);
+    prefixes[node].children[gene] = child;
+    return child;
+}
+
+int RHEA::getGenerations() const {
+    return generations;
+}
+
 Action RHEA::getActionFromGene(const Player* me, const Gene& gene) const {
-    return {gene.type, me->x + gene.dx, me->y + gene.dy};
+    return GameState::decode(gene, me->x, me->y);
 }
 
 void RHEA::calculateFitness() {
@@ -206,24 +332,93 @@ void RHEA::generateChildren() {
         mutation(chromosome);
 }
 
-int RHEA::chooseParentIndex() const {
-    eval_t fitnessSum = 0;
-    for (const auto& chromosome : population.chromosomes)
-        fitnessSum += chromosome.fitness;
-    assert(almostEqual<eval_t>(fitnessSum, 1));
+/* tables for drawing parents of the current population */
+void RHEA::prepareSelection() {
+    BENCH();
+    switch (selection) {
+        case Selection::roulette: {
+            eval_t pref = 0;
+            for (int i = 0; i < population.SIZE; ++i) {
+                pref += population.chromosomes[i].fitness;
+                selectionTable[i] = pref;
+            }
+            assert(almostEqual<eval_t>(pref, 1));
+            break;
+        }
+        case Selection::alias: {
+            /* Vose's method, every column is filled up to the average
+             * weight with the own index and the alias of the column */
+            int small[POP_SIZE], large[POP_SIZE];
+            int smallCount = 0, largeCount = 0;
+            for (int i = 0; i < population.SIZE; ++i) {
+                selectionTable[i] = population.chromosomes[i].fitness * population.SIZE;
+                aliasTable[i] = i;
+                if (selectionTable[i] < 1)
+                    small[smallCount++] = i;
+                else
+                    large[largeCount++] = i;
+            }
+            while (smallCount && largeCount) {
+                int less = small[--smallCount];
+                int more = large[largeCount - 1];
+                aliasTable[less] = more;
+                selectionTable[more] -= 1 - selectionTable[less];
+                if (selectionTable[more] < 1) {
+                    --largeCount;
+                    small[smallCount++] = more;
+                }
+            }
+            /* the rest is full up to rounding */
+            while (smallCount)
+                selectionTable[small[--smallCount]] = 1;
+            while (largeCount)
+                selectionTable[large[--largeCount]] = 1;
+            break;
+        }
+        case Selection::rank: {
+            /* the population is sorted, the best one weighs SIZE, the worst 1 */
+            eval_t pref = 0;
+            for (int i = 0; i < population.SIZE; ++i) {
+                pref += population.SIZE - i;
+                selectionTable[i] = pref;
+            }
+            break;
+        }
+        case Selection::tournament:
+            break;
+    }
+}
 
-    /* TODO: improve with binary search and prefix sum table */
-    eval_t value = Random::rand<eval_t>();
-    eval_t pref = 0;
-    for (int i = 0; i < population.SIZE; ++i) {
-        const auto& chromosome = population.chromosomes[i];
-        pref += chromosome.fitness;
-        if (value <= pref)
-            return i;
+int RHEA::chooseParentIndex() const {
+    switch (selection) {
+        case Selection::roulette:
+        case Selection::rank: {
+            /* value is drawn up to the total, but -ffast-math may still
+             * round it just above the last prefix */
+            eval_t value = Random::rand<eval_t>() * selectionTable[population.SIZE - 1];
+            int index = std::lower_bound(selectionTable,
+                selectionTable + population.SIZE, value) - selectionTable;
+            return std::min(index, population.SIZE - 1);
+        }
+        case Selection::alias: {
+            int index = Random::rand(population.SIZE);
+            return Random::rand<eval_t>() < selectionTable[index] ?
+                index : aliasTable[index];
+        }
+        case Selection::tournament: {
+            int best = Random::rand(population.SIZE);
+            for (int i = 1; i < TOURNAMENT_SIZE; ++i) {
+                int index = Random::rand(population.SIZE);
+                if (population.chromosomes[index].evaluation >
+                    population.chromosomes[best].evaluation)
+                    best = index;
+            }
+            return best;
+        }
     }
 
-    debug(pref, value);
     assert(false);
+    return 0;
 }
 
 void RHEA::crossover(const Chromosome& p1, const Chromosome& p2, 
@@ -305,7 +500,7 @@ void RHEA::replacePopulation() {
         children.SIZE * sizeof(Chromosome));
 
     for (const auto& chromosome : merged.chromosomes)
-        assert(chromosome.evaluation == evaluateChromosome(chromosome));
+        assert(chromosome.evaluation == evaluateChromosome(chromosome, prefixCaches[0]));
 
     std::partial_sort(merged.chromosomes,
         merged.chromosomes + population.SIZE,
@@ -332,13 +527,13 @@ Action RHEA::getBestAction() {
 
     Action bestAction;
     bool bestActionFound = false;
-    auto state = State::getInitialState(*game);
+    const State& state = initialState;
 
     for (const auto& gene : population.chromosomes[0].genes) {
         auto me = state.game.getPlayer(myid);
         assert(me);
         auto action = getActionFromGene(me, gene);
-        auto succInfo = state.succ({{myid, action}});
+        auto succInfo = state.succ(JointAction(myid, action));
 
         if (succInfo) {
             bestAction = action;
@@ -358,13 +553,13 @@ Action RHEA::getBestAction() {
     return bestAction;
 }
 
+/* the first gene was played, the plans continue with the rest */
 void RHEA::advanceHorizon() {
-    std::memmove(population.chromosomes,
-        population.chromosomes + 1,
-        (population.SIZE - 1) * sizeof(Chromosome));
-
-    for (auto& chromosome : population.chromosomes)
+    for (auto& chromosome : population.chromosomes) {
+        std::memmove(chromosome.genes, chromosome.genes + 1,
+            (HORIZON_LENGTH - 1) * sizeof(Gene));
         chromosome.genes[HORIZON_LENGTH - 1] = getRandomGene();
+    }
 }
 
 eval_t RHEA::eval(const State& s) {
@@ -381,10 +576,7 @@ eval_t RHEA::eval(const State& s) {
     points += 3.2 * std::min(s.myBombs, 3) + 1.9 * s.myBombs;
     points -= 0.2 * (s.myBombs - me->bombs);
 
-    for (int y = 0; y < s.game.H; ++y)
-        for (int x = 0; x < s.game.W; ++x)
-            if (s.game.board.isBox(x, y) && s.explosions.isOwner(x, y, s.game.myid))
-                points += 1 * (boxReward - s.explosions.e[y][x].time);
+    points += s.explosions.ownedReward(s.game.board.boxes, s.game.myid, boxReward);
             
     points -= 0.04 * std::abs(me->y - s.game.H * 0.5);
     points -= 0.04 * std::abs(me->x - s.game.W * 0.5);
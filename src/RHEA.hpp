@@ -3,6 +3,13 @@
 
 #include "Agent.hpp"
 #include "State.hpp"
+#include "ThreadPool.hpp"
+
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <cstdint>
 
 class RHEA : public Agent {
 public:
@@ -12,17 +19,63 @@ public:
     static constexpr int HORIZON_LENGTH = 8;
     static constexpr int OFFSPRING_SIZE = 100;
     static constexpr float MUTATION_PROBABILITY = 0.6;
+    /* chromosomes evaluated by a single task */
+    static constexpr int EVALUATION_CHUNK = 10;
+
+    /* how parents are drawn, roulette and alias in proportion to the
+     * fitness, tournament and rank by the order of the evaluations */
+    enum class Selection { roulette, alias, tournament, rank };
+    static constexpr int TOURNAMENT_SIZE = 3;
 
     static_assert(POP_SIZE <= OFFSPRING_SIZE,
         "Offspring size has to be strictly greater "
         "than population size!");
 
-    using Gene = Action;
+    using Gene = ActionCode;
     struct Chromosome {
         Gene genes[HORIZON_LENGTH];
         eval_t evaluation;
         eval_t fitness;
     };
+    /* trie of the states reached by gene prefixes of the chromosomes
+     * evaluated in one turn, evaluations resume from the longest
+     * prefix found; every thread of the pool of the agent has its
+     * own, so it is never shared */
+    class PrefixCache {
+    public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+        static constexpr uint32_t ROOT = 0;
+        /* the trie is cleared when full, the last generations
+         * are the ones that share prefixes with the next one */
+        static constexpr int MAX_PREFIXES = 1 << 12;
+
+        struct Prefix {
+            State state;
+            int actionsDone;
+            int canSurvive;
+            uint32_t children[GameState::ACTION_CODES];
+        };
+
+        /* drops all the prefixes if they were built in another turn,
+         * unless it is the previous turn of the agent, which played
+         * gene and reached the observed state, then the prefixes
+         * starting with gene are kept for the rest of their genes */
+        void prepare(unsigned long turn, unsigned long previousTurn,
+                     Gene gene, const State& initialState);
+        inline uint32_t child(uint32_t node, Gene gene) const;
+        /* NONE if there is no room for the child */
+        uint32_t addChild(uint32_t node, Gene gene);
+        inline Prefix& operator[](uint32_t node);
+
+    private:
+        /* keeps only the root */
+        void clear();
+        bool reroot(Gene gene, const State& initialState);
+
+        unsigned long turn = 0;
+        std::vector<Prefix> prefixes;
+    };
+
     template<int _SIZE>
     struct Population {
         static constexpr int SIZE = _SIZE;
@@ -30,10 +83,12 @@ public:
     };  
 
 public:
-    RHEA();
+    explicit RHEA(int threads = 1, Selection selection = Selection::roulette);
 
     Action getAction(const GameState& game,
-                     const int timeLimit) override;
+                     const Budget& budget) override;
+    /* generations done in the last getAction */
+    int getGenerations() const;
     
     static eval_t eval(const State& state);
 
@@ -44,10 +99,12 @@ private:
     Gene getRandomGene() const;
     Action getActionFromGene(const Player* me, const Gene& gene) const;
     template<int SIZE>
-    void evaluatePopulation(Population<SIZE>& population) const;
-    eval_t evaluateChromosome(const Chromosome& chromosome) const;
+    void evaluatePopulation(Population<SIZE>& population);
+    eval_t evaluateChromosome(const Chromosome& chromosome,
+                              PrefixCache& cache) const;
     void calculateFitness();
     void generateChildren();
+    void prepareSelection();
     int chooseParentIndex() const;
     void crossover(const Chromosome& p1, const Chromosome& p2,
                    Chromosome& c1, Chromosome& c2) const;
@@ -57,8 +114,9 @@ private:
                           Chromosome& c1, Chromosome& c2) const;
     void mutation(Chromosome& chromosome) const;
     void replacePopulation();
+    /* evaluates again with the cache of the thread running getAction */
     template<int SIZE>
-    bool sortedSanityCheck(const Population<SIZE>& population) const;
+    bool sortedSanityCheck(const Population<SIZE>& population);
     Action getBestAction();
     void advanceHorizon();
     template<int SIZE>
@@ -66,25 +124,62 @@ private:
 
 private:
     const GameState* game = nullptr;
-    std::set<Gene> possibleGenes;
-    std::vector<Gene> possibleGenesVec;
+    /* root of every evaluation, copied by each of them */
+    State initialState;
+    /* number of the current getAction, identifies the prefix
+     * caches filled during it */
+    unsigned long turn = 0;
+    /* turn before and the gene played in it, all of the chromosomes
+     * are shifted by this gene for the next turn */
+    unsigned long previousTurn = 0;
+    Gene playedGene = 0;
+    ActionMask possibleGenes = 0;
+    InlineVector<Gene, GameState::ACTION_CODES> possibleGenesVec;
 
     Population<POP_SIZE> population;
     Population<OFFSPRING_SIZE> children;
     Population<POP_SIZE + OFFSPRING_SIZE> merged;
+
+    std::unique_ptr<ThreadPool> threadPool;
+    /* indexed by ThreadPool::worker */
+    std::vector<PrefixCache> prefixCaches;
+
+    Selection selection;
+    /* prefix sums of the weights for roulette and rank selection,
+     * probabilities of the own index for alias selection */
+    eval_t selectionTable[POP_SIZE];
+    int aliasTable[POP_SIZE];
+    int generations = 0;
 };
 
+uint32_t RHEA::PrefixCache::child(uint32_t node, Gene gene) const {
+    return prefixes[node].children[gene];
+}
+
+RHEA::PrefixCache::Prefix& RHEA::PrefixCache::operator[](uint32_t node) {
+    return prefixes[node];
+}
+
 template<int SIZE>
-void RHEA::evaluatePopulation(Population<SIZE>& population) const {
+void RHEA::evaluatePopulation(Population<SIZE>& population) {
     BENCH();
-    for (auto& chromosome : population.chromosomes)
-        chromosome.evaluation = evaluateChromosome(chromosome);
+    /* chromosomes are independent, every task fills its own range */
+    int chunks = (SIZE + EVALUATION_CHUNK - 1) / EVALUATION_CHUNK;
+    threadPool->run(chunks, [&](int c) {
+        State::evalFunction = eval;
+        GameState::myid = myid;
+        auto& cache = prefixCaches[ThreadPool::worker()];
+        int end = std::min(SIZE, (c + 1) * EVALUATION_CHUNK);
+        for (int i = c * EVALUATION_CHUNK; i < end; ++i)
+            population.chromosomes[i].evaluation =
+                evaluateChromosome(population.chromosomes[i], cache);
+    });
 }
 
 template<int SIZE>
-bool RHEA::sortedSanityCheck(const Population<SIZE>& population) const {
+bool RHEA::sortedSanityCheck(const Population<SIZE>& population) {
     for (const auto& chromosome : population.chromosomes)
-        if (evaluateChromosome(chromosome) != chromosome.evaluation)
+        if (evaluateChromosome(chromosome, prefixCaches[0]) != chromosome.evaluation)
             return false;
     for (int i = 0; i < population.SIZE - 1; ++i)
         if (population.chromosomes[i].evaluation < population.chromosomes[i + 1].evaluation)
@@ -1,6 +1,6 @@
 #include "State.hpp"
 
-std::function<State::eval_t(const State&)> State::evalFunction = State::defaultEval;
+thread_local std::function<State::eval_t(const State&)> State::evalFunction = State::defaultEval;
 
 State State::getInitialState(const GameState& game) {
     State initialState;
@@ -19,14 +19,15 @@ State State::getInitialState(const GameState& game) {
     return initialState;
 }
 
+/* random action among the valid ones */
 Action State::getRandomAction() {
     auto me = game.getPlayer(game.myid);
     assert(me);
-    int dir = Random::rand(game.DIR_COUNT);
-    return {
-        game.actionTypes[Random::rand(game.MAX_ACTION_TYPES)],
-        me->x + game.dx[dir], me->y + game.dy[dir]
-    };
+    ActionMask mask = game.getActionMask(game.myid);
+    assert(mask);
+    for (int k = Random::rand(__builtin_popcount(mask)); k > 0; --k)
+        mask &= mask - 1;
+    return game.decode(__builtin_ctz(mask), me->x, me->y);
 }
 
 State::eval_t State::eval() {
@@ -35,7 +36,7 @@ State::eval_t State::eval() {
 
 hash_t State::getHash() {
     hash_t power = 1e9 + 123;
-    hash_t hash = 0;
+    hash_t hash = game.hash;
     auto addHashElem = [power](hash_t& h, hash_t x) {
         h = h * power + x;
     };
@@ -46,48 +47,10 @@ hash_t State::getHash() {
     addHashElem(hash, myBombs);
     addHashElem(hash, boxSum);
 
-    for (int y = 0; y < game.H; ++y)
-        for (int x = 0; x < game.W; ++x)
-            addHashElem(hash, explosions.e[y][x].time);
-
-    hash_t playersHash = 0;
-    for (const auto& player : game.players) {
-        hash_t pHash = 0;
-        addHashElem(pHash, player.id);
-        addHashElem(pHash, player.x);
-        addHashElem(pHash, player.y);
-        addHashElem(pHash, player.bombs);
-        addHashElem(pHash, player.range);
-        playersHash ^= pHash;
-    }
-    addHashElem(hash, playersHash);
-
-    hash_t bombsHash = 0;
-    for (const auto& bomb : game.bombs) {
-        hash_t bHash = 0;
-        addHashElem(bHash, bomb.owner);
-        addHashElem(bHash, bomb.x);
-        addHashElem(bHash, bomb.y);
-        addHashElem(bHash, bomb.time);
-        addHashElem(bHash, bomb.range);
-        bombsHash ^= bHash;
-    }
-    addHashElem(hash, bombsHash);
-
-    hash_t itemsHash = 0;
-    for (const auto& item : game.items) {
-        hash_t iHash = 0;
-        addHashElem(iHash, item.x);
-        addHashElem(iHash, item.y);
-        addHashElem(iHash, hash_t(item.type));
-        itemsHash ^= iHash;
-    }
-    addHashElem(hash, itemsHash);
-
     return hash;
 }
 
-std::optional<State> State::succ(const Actions& actions) const {
+std::optional<State> State::succ(const JointAction& actions) const {
     auto succInfo = game.succ(explosions, actions);
     if (!succInfo)
         return {};
@@ -96,11 +59,14 @@ std::optional<State> State::succ(const Actions& actions) const {
 
     State nextState;
     nextState.game = nextGame;
-    nextState.explosions = nextState.game.getExplosions();
+    nextState.explosions = nextState.game.getExplosions(game, explosions);
 
-    assert(actions.count(game.myid));
-    if (firstLayer)
-        nextState.firstAction = actions.at(game.myid);
+    assert(actions.has(game.myid));
+    if (firstLayer) {
+        auto me = game.getPlayer(game.myid);
+        assert(me);
+        nextState.firstAction = game.encode(actions.at(game.myid), me->x, me->y);
+    }
     else
         nextState.firstAction = firstAction;
 
@@ -135,10 +101,7 @@ State::eval_t State::defaultEval(const State& s) {
     points += 3.4 * std::min(2, s.myBombs) + 1.7 * std::min(4, s.myBombs) + 0.7 * s.myBombs;
     points -= 0.17 * (s.myBombs - me->bombs);
 
-    for (int y = 0; y < s.game.H; ++y)
-        for (int x = 0; x < s.game.W; ++x)
-            if (s.game.board.isBox(x, y) && s.explosions.isOwner(x, y, s.game.myid))
-                points += boxReward - s.explosions.e[y][x].time;
+    points += s.explosions.ownedReward(s.game.board.boxes, s.game.myid, boxReward);
             
     points -= 0.04 * std::abs(me->y - s.game.H * 0.5);
     points -= 0.04 * std::abs(me->x - s.game.W * 0.5);
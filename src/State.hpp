@@ -14,17 +14,19 @@ struct State {
 
     eval_t eval();
     hash_t getHash();
-    std::optional<State> succ(const Actions& actions) const;
+    std::optional<State> succ(const JointAction& actions) const;
     bool canSurvive() const;
 
     static eval_t defaultEval(const State& state);
     bool operator>(const State& other) const;
 
-    static std::function<eval_t(const State&)> evalFunction;
+    /* per thread, so that agents searching in parallel
+     * have to set it in every thread they use */
+    static thread_local std::function<eval_t(const State&)> evalFunction;
 
     GameState game;
     Explosions explosions;
-    Action firstAction;
+    ActionCode firstAction = 0;
     eval_t score = 0.0;
     hash_t hash = 0;
     int myRange = 0, myBombs = 0;
@@ -32,4 +34,7 @@ struct State {
     bool firstLayer = true;
 };
 
+static_assert(std::is_trivially_copyable_v<State>,
+    "State has to be copyable with memcpy!");
+
 #endif /* STATE_HPP */
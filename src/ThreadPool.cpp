@@ -0,0 +1,93 @@
+#include "ThreadPool.hpp"
+
+#include <cassert>
+
+namespace {
+    thread_local int currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(int threads) {
+    assert(threads >= 1);
+    for (int i = 1; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    started.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::run(int tasks, const task_t& task) {
+    /* the caller may itself be a worker of another pool */
+    int outerWorker = currentWorker;
+    currentWorker = 0;
+    if (workers.empty()) {
+        for (int i = 0; i < tasks; ++i)
+            task(i);
+        currentWorker = outerWorker;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->tasks = tasks;
+        next = 0;
+        ++batch;
+    }
+    started.notify_all();
+
+    process(task, tasks);
+
+    /* workers that joined the batch may still run its last tasks,
+     * the batch must not outlive them */
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]{ return busy == 0; });
+    this->task = nullptr;
+    currentWorker = outerWorker;
+}
+
+int ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+int ThreadPool::worker() {
+    return currentWorker;
+}
+
+void ThreadPool::work(int index) {
+    currentWorker = index;
+    unsigned seen = 0;
+    while (true) {
+        const task_t* task;
+        int tasks;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&]{ return stop || (this->task && batch != seen); });
+            if (stop)
+                return;
+            seen = batch;
+            task = this->task;
+            tasks = this->tasks;
+            ++busy;
+        }
+
+        process(*task, tasks);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busy;
+        }
+        finished.notify_all();
+    }
+}
+
+void ThreadPool::process(const task_t& task, int tasks) {
+    for (int i = next++; i < tasks; i = next++)
+        task(i);
+}
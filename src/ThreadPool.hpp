@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/* fixed set of threads running batches of tasks, the thread calling
+ * run takes part in the batch, so a pool of size 1 spawns nothing */
+class ThreadPool {
+public:
+    using task_t = std::function<void(int)>;
+
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /* calls task(i) for every i from [0, tasks) and waits for all
+     * of them, tasks are handed out to threads one by one */
+    void run(int tasks, const task_t& task);
+    int size() const;
+    /* index from [0, size()) of the calling thread in the pool whose
+     * task it runs, 0 for the thread that called run, so that tasks
+     * can keep per thread data in the object that owns the pool */
+    static int worker();
+
+private:
+    void work(int index);
+    void process(const task_t& task, int tasks);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable started, finished;
+
+    /* current batch, guarded by mutex */
+    const task_t* task = nullptr;
+    int tasks = 0;
+    unsigned batch = 0;
+    int busy = 0;
+    bool stop = false;
+
+    std::atomic<int> next{0};
+};
+
+#endif /* THREAD_POOL_HPP */
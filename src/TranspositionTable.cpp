@@ -0,0 +1,106 @@
+#include "TranspositionTable.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    /* layout of the data word */
+    constexpr int VISITS_SHIFT = 32;
+    constexpr int DEPTH_SHIFT = 44;
+    constexpr int AGE_SHIFT = 50;
+    constexpr uint64_t VALID = uint64_t(1) << 63;
+    /* 9 bits, longer than a game, when it wraps the table is
+     * cleared anyway, an entry of an old turn never reads as current */
+    constexpr int AGE_MASK = (1 << 9) - 1;
+}
+
+TranspositionTable::TranspositionTable(int bucketsLog) :
+    slots(new Slot[(size_t(1) << bucketsLog) * WAYS]),
+    mask((uint64_t(1) << bucketsLog) - 1) {
+}
+
+void TranspositionTable::newTurn() {
+    age = (age + 1) & AGE_MASK;
+    if (age == 0)
+        clear();
+}
+
+void TranspositionTable::clear() {
+    for (uint64_t i = 0; i < (mask + 1) * WAYS; ++i) {
+        slots[i].check.store(0, std::memory_order_relaxed);
+        slots[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool TranspositionTable::probe(hash_t key, Entry& entry) const {
+    const Slot* bucket = &slots[(key & mask) * WAYS];
+    for (int i = 0; i < WAYS; ++i) {
+        uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+        uint64_t check = bucket[i].check.load(std::memory_order_relaxed);
+        if ((data & VALID) && (check ^ data) == key) {
+            entry = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(hash_t key, const Entry& entry) {
+    Slot* bucket = &slots[(key & mask) * WAYS];
+
+    Entry entries[WAYS];
+    bool valid[WAYS];
+    for (int i = 0; i < WAYS; ++i) {
+        uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+        uint64_t check = bucket[i].check.load(std::memory_order_relaxed);
+        valid[i] = data & VALID;
+        entries[i] = unpack(data);
+        if (valid[i] && (check ^ data) == key) {
+            write(bucket[i], key, entry);
+            return;
+        }
+    }
+
+    int victim = 0;
+    for (int i = 0; i < WAYS; ++i) {
+        if (!valid[i]) {
+            write(bucket[i], key, entry);
+            return;
+        }
+
+        const Entry& worst = entries[victim];
+        const Entry& other = entries[i];
+        if ((worst.current && !other.current) ||
+            (worst.current == other.current &&
+                (other.visits < worst.visits ||
+                (other.visits == worst.visits && other.depth > worst.depth))))
+            victim = i;
+    }
+    write(bucket[victim], key, entry);
+}
+
+void TranspositionTable::write(Slot& slot, hash_t key, const Entry& entry) {
+    uint64_t data = pack(entry);
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+uint64_t TranspositionTable::pack(const Entry& entry) const {
+    uint32_t evaluation;
+    std::memcpy(&evaluation, &entry.evaluation, sizeof(evaluation));
+    return evaluation |
+        uint64_t(std::clamp(entry.visits, 0, MAX_VISITS)) << VISITS_SHIFT |
+        uint64_t(std::clamp(entry.depth, 0, MAX_DEPTH)) << DEPTH_SHIFT |
+        uint64_t(age) << AGE_SHIFT |
+        VALID;
+}
+
+TranspositionTable::Entry TranspositionTable::unpack(uint64_t data) const {
+    Entry entry;
+    uint32_t evaluation = data;
+    std::memcpy(&entry.evaluation, &evaluation, sizeof(evaluation));
+    entry.visits = data >> VISITS_SHIFT & MAX_VISITS;
+    entry.depth = data >> DEPTH_SHIFT & MAX_DEPTH;
+    entry.current = int(data >> AGE_SHIFT & AGE_MASK) == age;
+    return entry;
+}
@@ -0,0 +1,58 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include "Common.hpp"
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/* fixed size table of search results keyed by the hash of a state,
+ * kept over turns; MCTS keeps the mean of the rollouts of a state in
+ * it, BeamSearch marks the states already in the beam of the turn;
+ * it is lock free, an entry is two words and the key is stored xored
+ * with the data, so an entry torn by concurrent writes fails the check
+ * of the key and is read as a miss */
+class TranspositionTable {
+public:
+    static constexpr int MAX_VISITS = (1 << 12) - 1;
+    static constexpr int MAX_DEPTH = (1 << 6) - 1;
+
+    struct Entry {
+        float evaluation = 0;
+        int depth = 0;
+        int visits = 0;
+        /* stored after the last newTurn */
+        bool current = false;
+    };
+
+    /* 2^bucketsLog buckets of WAYS entries */
+    explicit TranspositionTable(int bucketsLog = 16);
+
+    /* entries of the previous turns are replaced first */
+    void newTurn();
+    void clear();
+
+    bool probe(hash_t key, Entry& entry) const;
+    /* replaces the entry of the key, otherwise an entry of an old turn,
+     * otherwise the one with fewer visits, then the deeper one */
+    void store(hash_t key, const Entry& entry);
+
+private:
+    static constexpr int WAYS = 2;
+
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    void write(Slot& slot, hash_t key, const Entry& entry);
+    uint64_t pack(const Entry& entry) const;
+    Entry unpack(uint64_t data) const;
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+    int age = 0;
+};
+
+#endif /* TRANSPOSITION_TABLE_HPP */
@@ -0,0 +1,38 @@
+#include "Zobrist.hpp"
+
+namespace Zobrist {
+    hash_t boxKeys[CELLS][BOX_TYPES];
+    hash_t itemKeys[CELLS][ITEM_TYPES];
+    hash_t playerKeys[MAX_PLAYERS][CELLS];
+    hash_t playerBombsKeys[MAX_PLAYERS][MAX_STAT];
+    hash_t playerRangeKeys[MAX_PLAYERS][MAX_STAT];
+    hash_t bombTimeKeys[CELLS][MAX_TIME + 1];
+    hash_t bombOwnerKeys[CELLS][MAX_PLAYERS];
+    hash_t bombRangeKeys[CELLS][MAX_STAT];
+
+    namespace {
+        /* fixed seed, so hashes are the same in every run */
+        constexpr std::mt19937_64::result_type SEED = 0x5eed;
+
+        template<int N, int M>
+        void fill(hash_t (&keys)[N][M], std::mt19937_64& gen) {
+            for (auto& row : keys)
+                for (auto& key : row)
+                    key = gen();
+        }
+
+        struct Initializer {
+            Initializer() {
+                std::mt19937_64 gen(SEED);
+                fill(boxKeys, gen);
+                fill(itemKeys, gen);
+                fill(playerKeys, gen);
+                fill(playerBombsKeys, gen);
+                fill(playerRangeKeys, gen);
+                fill(bombTimeKeys, gen);
+                fill(bombOwnerKeys, gen);
+                fill(bombRangeKeys, gen);
+            }
+        } initializer;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+
+#include "Common.hpp"
+
+/* random keys for Zobrist hashing of the game state, the hash of a state
+ * is xor of the keys of all boxes, items, players and bombs, so it is
+ * updated by xoring out the keys of what changed and xoring in the new ones */
+namespace Zobrist {
+    constexpr int H = 11;
+    constexpr int W = 13;
+    constexpr int CELLS = H * W;
+    constexpr int MAX_PLAYERS = 4;
+    constexpr int MAX_TIME = 8;
+    constexpr int BOX_TYPES = 3;
+    constexpr int ITEM_TYPES = 2;
+    /* player stats and bomb ranges above that share the keys */
+    constexpr int MAX_STAT = 32;
+
+    extern hash_t boxKeys[CELLS][BOX_TYPES];
+    extern hash_t itemKeys[CELLS][ITEM_TYPES];
+    extern hash_t playerKeys[MAX_PLAYERS][CELLS];
+    extern hash_t playerBombsKeys[MAX_PLAYERS][MAX_STAT];
+    extern hash_t playerRangeKeys[MAX_PLAYERS][MAX_STAT];
+    extern hash_t bombTimeKeys[CELLS][MAX_TIME + 1];
+    extern hash_t bombOwnerKeys[CELLS][MAX_PLAYERS];
+    extern hash_t bombRangeKeys[CELLS][MAX_STAT];
+
+    inline int cell(int x, int y) {
+        return y * W + x;
+    }
+
+    /* type is the box type, 0 for an empty box, 1 range, 2 bomb */
+    inline hash_t box(int x, int y, int type) {
+        return boxKeys[cell(x, y)][type];
+    }
+
+    /* type is 1 for range, 2 for bomb */
+    inline hash_t item(int x, int y, int type) {
+        return itemKeys[cell(x, y)][type - 1];
+    }
+
+    inline hash_t player(int id, int x, int y, int bombs, int range) {
+        return playerKeys[id][cell(x, y)] ^
+            playerBombsKeys[id][bombs % MAX_STAT] ^
+            playerRangeKeys[id][range % MAX_STAT];
+    }
+
+    inline hash_t bomb(int owner, int x, int y, int time, int range) {
+        return bombTimeKeys[cell(x, y)][time] ^
+            bombOwnerKeys[cell(x, y)][owner] ^
+            bombRangeKeys[cell(x, y)][range % MAX_STAT];
+    }
+}
+
+#endif /* ZOBRIST_HPP */
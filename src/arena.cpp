@@ -4,13 +4,27 @@
 #include "RHEA.hpp"
 #include "Dummy.hpp"
 
+#include <thread>
+
+/* threads an agent searches with, agents of a game move one after
+ * another, so a game keeps that many cores busy; the agents below
+ * are built with their default of a single thread */
+static constexpr int AGENT_THREADS = 1;
+
 int main() {
     int times = 100;
+    /* games in parallel, so that they do not compete for the cores */
+    int threads = std::max(1, int(std::thread::hardware_concurrency()) / AGENT_THREADS);
+
+    /* stop as soon as RHEA is shown to be 50 elo better or not */
+    MatchStats::SPRT sprt;
+    sprt.elo0 = 0.f;
+    sprt.elo1 = 50.f;
 
     Arena arena;
     arena.fight<
         RHEA,
-        MCTS>(times);
+        MCTS>(times, threads, sprt);
 
     return 0;
-}
\ No newline at end of file
+}
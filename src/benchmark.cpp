@@ -1,47 +1,276 @@
 #include "GameState.hpp"
 #include "Common.hpp"
 #include "State.hpp"
+#include "BeamSearch.hpp"
+#include "MCTS.hpp"
+#include "RHEA.hpp"
 
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <chrono>
+
+static constexpr int ROUNDS = 10;
+/* calls of an operation in a round are chosen to take about that long */
+static constexpr double ROUND_TIME = 20e6;
 static constexpr int MAX_TURNS = 15;
 static constexpr int TIME_LIMIT = 500;
+static constexpr int RHEA_TURNS = 5;
 
-int main() {
+static const char* const POSITION_DIRS[] = {"benchmarks", "tests"};
+
+struct Position {
+    std::string name;
     int myid;
-    GameState gameState;
-    int totalTurns = 0;
-    int deadRounds = 0;
-    int allRounds = 0;
+    GameState game;
+};
 
-    std::cin >> myid;
-    std::cin >> gameState;
+/* position files start either with the id of the player (benchmarks/)
+ * or with the width, the height and the id (tests/), as on the input */
+static bool loadPosition(const std::string& filename, Position& position) {
+    std::ifstream file(filename);
+    std::string header;
+    if (!std::getline(file, header))
+        return false;
 
-    State initialState = State::getInitialState(gameState);
+    std::istringstream in(header);
+    std::vector<int> values;
+    for (int value; in >> value; )
+        values.push_back(value);
+    if (values.size() != 1 && values.size() != 3)
+        return false;
 
-    Timer timer(TIME_LIMIT);
-    while (timer.isTimeLeft()) {
-        State state = initialState;
+    position.name = filename;
+    position.myid = values.back();
 
-        for (int i = 0; i < MAX_TURNS && timer.isTimeLeft(); ++i) {
-            std::vector<Action> actions = state.game.getActions();
-            int actionIdx = Random::rand<int>(0, actions.size() - 1);
-            const auto& action = actions[actionIdx];
+    /* reading echoes the board */
+    auto buffer = std::cerr.rdbuf(nullptr);
+    file >> position.game;
+    std::cerr.rdbuf(buffer);
+    std::cerr.clear();
 
-            auto next = state.succ({{ myid, action }});
-            ++totalTurns;
-            if (!next) {
-                ++deadRounds;
-                break;
-            }
+    return bool(file) && position.game.getPlayer(position.myid);
+}
+
+static std::vector<Position> loadPositions() {
+    std::vector<std::string> filenames;
+    for (const auto& dir : POSITION_DIRS) {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, error))
+            if (entry.path().extension() == ".txt")
+                filenames.push_back(entry.path().string());
+    }
+    std::sort(all(filenames));
+
+    std::vector<Position> positions;
+    for (const auto& filename : filenames) {
+        Position position;
+        if (loadPosition(filename, position))
+            positions.push_back(position);
+        else
+            std::cout << "skipping " << filename << std::endl;
+    }
+    return positions;
+}
+
+/* an operation is called on the position and on all its successors in
+ * turn, so that caches keyed by the state are not hit every time */
+struct Case {
+    GameState game;
+    Explosions explosions;
+    State state;
+    Action action;
+};
+
+/* actions of player id that validActions accepts */
+static std::vector<Action> getActions(const GameState& game, int id) {
+    auto player = game.getPlayer(id);
+    std::vector<Action> actions;
+    for (ActionMask mask = game.getActionMask(id); mask; mask &= mask - 1)
+        actions.push_back(GameState::decode(__builtin_ctz(mask), player->x, player->y));
+    return actions;
+}
+
+static std::vector<Case> getCases(const Position& position) {
+    std::vector<GameState> games = {position.game};
+    for (const auto& action : getActions(position.game, position.myid)) {
+        auto succInfo = position.game.succ(position.game.getExplosions(),
+            JointAction(position.myid, action));
+        if (succInfo && succInfo->first.getPlayer(position.myid))
+            games.push_back(succInfo->first);
+    }
+
+    std::vector<Case> cases;
+    for (const auto& game : games) {
+        auto actions = getActions(game, position.myid);
+        for (const auto& action : actions)
+            cases.push_back({game, game.getExplosions(),
+                State::getInitialState(game), action});
+    }
+    return cases;
+}
+
+static volatile uint64_t sink;
+
+/* calls op(i) for consecutive i in ROUNDS rounds, reports the mean
+ * time of a call, the number of calls per second and the variance
+ * of the mean time between the rounds */
+template<typename F>
+void measure(const std::string& name, F op) {
+    using clock_t = std::chrono::high_resolution_clock;
+    uint64_t sum = 0;
+    int index = 0;
+    auto run = [&](long calls) {
+        auto start = clock_t::now();
+        for (long k = 0; k < calls; ++k)
+            sum += uint64_t(op(index++));
+        return std::chrono::duration<double, std::nano>(clock_t::now() - start).count();
+    };
+
+    long calls = 1;
+    for (double passed = run(calls); passed < ROUND_TIME / 10; passed = run(calls))
+        calls *= 2;
+    calls = std::max(1L, long(calls * ROUND_TIME / std::max(run(calls), 1.0)));
+
+    double times[ROUNDS];
+    for (int r = 0; r < ROUNDS; ++r)
+        times[r] = run(calls) / calls;
+    sink = sum;
+
+    double mean = 0, variance = 0;
+    for (double time : times)
+        mean += time / ROUNDS;
+    for (double time : times)
+        variance += (time - mean) * (time - mean) / (ROUNDS - 1);
+
+    std::cout << "  " << std::left << std::setw(22) << name << std::right
+              << std::fixed << std::setprecision(1)
+              << std::setw(12) << mean << " ns/op"
+              << std::setprecision(0) << std::setw(12) << 1e9 / mean << " ops/s"
+              << std::setprecision(1) << "   variance " << variance << " ns^2 ("
+              << 100 * std::sqrt(variance) / mean << "%)" << std::endl;
+}
+
+static void benchmark(const Position& position) {
+    GameState::myid = position.myid;
+    State::evalFunction = State::defaultEval;
+    auto cases = getCases(position);
+    int n = cases.size();
+    int myid = position.myid;
 
+    std::cout << position.name << " (" << n << " cases)" << std::endl;
+
+    measure("getExplosions", [&](int i) {
+        const auto& game = cases[i % n].game;
+        return game.getExplosions().e[i % game.H][i % game.W].time;
+    });
+    measure("GameState::succ", [&](int i) {
+        const auto& c = cases[i % n];
+        auto succInfo = c.game.succ(c.explosions, JointAction(myid, c.action));
+        return succInfo ? succInfo->first.hash : 0;
+    });
+    measure("validActions", [&](int i) {
+        const auto& c = cases[i % n];
+        return c.game.validActions(JointAction(myid, c.action));
+    });
+    measure("canSurvive", [&](int i) {
+        const auto& c = cases[i % n];
+        return c.game.canSurvive(c.explosions);
+    });
+    /* getSafeActions is cached, this is what agents pay,
+     * _getSafeActions below it is the uncached work */
+    measure("getSafeActions", [&](int i) {
+        return cases[i % n].game.getSafeActions();
+    });
+    measure("_getSafeActions", [&](int i) {
+        const auto& c = cases[i % n];
+        return c.game._getSafeActions(c.explosions, JointAction(),
+            c.game.getActionMask(myid));
+    });
+    measure("State::succ", [&](int i) {
+        const auto& c = cases[i % n];
+        auto next = c.state.succ(JointAction(myid, c.action));
+        return next ? next->hash : 0;
+    });
+    measure("State::getHash", [&](int i) {
+        return cases[i % n].state.getHash();
+    });
+    measure("State::defaultEval", [&](int i) {
+        return State::defaultEval(cases[i % n].state) > 0;
+    });
+    measure("BeamSearch::eval", [&](int i) {
+        return BeamSearch::eval(cases[i % n].state) > 0;
+    });
+    measure("MCTS::eval", [&](int i) {
+        return MCTS::eval(cases[i % n].state) > 0;
+    });
+    measure("RHEA::eval", [&](int i) {
+        return RHEA::eval(cases[i % n].state) > 0;
+    });
+
+    /* random playout of at most MAX_TURNS turns from the position */
+    State initialState = State::getInitialState(position.game);
+    measure("random playout", [&](int) {
+        State state = initialState;
+        int turns = 0;
+        for (; turns < MAX_TURNS; ++turns) {
+            auto me = state.game.getPlayer(myid);
+            ActionMask mask = state.game.getActionMask(myid);
+            for (int skip = Random::rand(__builtin_popcount(mask)); skip; --skip)
+                mask &= mask - 1;
+            auto action = GameState::decode(__builtin_ctz(mask), me->x, me->y);
+            auto next = state.succ(JointAction(myid, action));
+            if (!next)
+                break;
             state = next.value();
         }
+        return turns;
+    });
 
-        ++allRounds;
+    /* generations of RHEA per turn with every selection */
+    const std::pair<RHEA::Selection, const char*> selections[] = {
+        {RHEA::Selection::roulette, "roulette"},
+        {RHEA::Selection::alias, "alias"},
+        {RHEA::Selection::tournament, "tournament"},
+        {RHEA::Selection::rank, "rank"},
+    };
+    for (const auto& [selection, name] : selections) {
+        RHEA agent(1, selection);
+        agent.init(position.game.H, position.game.W, myid, false);
+        /* the turns are timed themselves, as the agent leaves a margin
+         * of its time limit unused */
+        int generations = 0;
+        double passed = 0;
+        for (int i = 0; i < RHEA_TURNS; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            agent.getAction(position.game, TIME_LIMIT / RHEA_TURNS);
+            passed += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+            generations += agent.getGenerations();
+        }
+        std::cout << "  RHEA " << name << " selection: ";
+        if (generations == 0)
+            std::cout << "no generation in " << std::setprecision(1) << passed << "ms" << std::endl;
+        else
+            std::cout << std::setprecision(3) << passed / generations << "ms/generation" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    auto positions = loadPositions();
+    if (positions.empty()) {
+        std::cout << "no positions found, run it from the top directory" << std::endl;
+        return 1;
     }
 
-    std::cout << "dead/all rounds: " << deadRounds << "/" << allRounds << std::endl;
-    std::cout << "totalTurns: " << totalTurns << std::endl;
-    std::cout << totalTurns / allRounds << std::endl;
+    for (const auto& position : positions)
+        benchmark(position);
 
     return 0;
 }
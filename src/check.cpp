@@ -0,0 +1,207 @@
+#include "GameState.hpp"
+#include "Common.hpp"
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+/* checks of the incremental updates of GameState against computing
+ * them from scratch, they do not rely on assert, so they also run in
+ * the release build */
+
+static int failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __FILE__, __LINE__)
+
+static bool check(bool condition, const char* text, const char* file, int line) {
+    if (!condition) {
+        std::cout << file << ":" << line << ": check failed: " << text << std::endl;
+        ++failures;
+    }
+    return condition;
+}
+
+static GameState emptyGame() {
+    GameState game;
+    game.hash = game.computeHash();
+    return game;
+}
+
+/* two players on one cell can both place a bomb there, only the last
+ * bomb of the cell blasts, the blast has to reach the cells of another
+ * bomb that has just exploded with the owner and range of that bomb */
+static void testStackedBombs() {
+    GameState game = emptyGame();
+    game.players.push_back({0, 0, 0, 1, 3});
+    game.bombs.push_back({0, 6, 8, 1, 2});
+    game.bombs.push_back({1, 6, 6, 5, 3});
+    game.bombs.push_back({2, 6, 6, 5, 4});
+    game.hash = game.computeHash();
+
+    GameState::myid = 0;
+    auto explosions = game.getExplosions();
+    CHECK(explosions.e[8][6].time == 1);
+
+    auto succInfo = game.succ(explosions, JointAction());
+    if (!CHECK(succInfo.has_value()))
+        return;
+    const auto& next = succInfo->first;
+    /* (6, 8) exploded just now, so it is stale in the timeline */
+    auto incremental = next.getExplosions(game, explosions);
+    auto full = next.getExplosions();
+    CHECK(incremental == full);
+    CHECK(full.e[8][6].time == 4);
+    CHECK(full.e[8][6].ownerMask == 1 << 2);
+    CHECK(full.e[9][6].ownerMask == 1 << 2);
+}
+
+/* successors of one turn and what happened in them */
+struct Coverage {
+    int turns = 0;
+    int stackedBombs = 0;
+    int droppedItems = 0;
+    int pickedItems = 0;
+    int droppedAndPicked = 0;
+};
+
+static GameState randomGame(const GameState& board, std::mt19937& rng) {
+    GameState game = emptyGame();
+    game.board = board.board;
+
+    std::vector<std::pair<int, int>> empty;
+    for (int y = 0; y < game.H; ++y)
+        for (int x = 0; x < game.W; ++x)
+            if (game.board.isEmpty(x, y))
+                empty.push_back({x, y});
+
+    /* players often start on one cell, so that they stack bombs */
+    int playerCount = 2 + rng() % 3;
+    auto cell = empty[rng() % empty.size()];
+    for (int id = 0; id < playerCount; ++id) {
+        if (rng() % 3 == 0)
+            cell = empty[rng() % empty.size()];
+        game.players.push_back({id, cell.first, cell.second,
+            int(1 + rng() % 3), int(2 + rng() % 4)});
+    }
+    for (int i = 0; i < 6; ++i) {
+        auto [x, y] = empty[rng() % empty.size()];
+        bool taken = false;
+        for (const auto& item : game.items)
+            taken |= item.x == x && item.y == y;
+        if (!taken)
+            game.items.push_back({x, y, rng() % 2 ? ItemType::range : ItemType::bomb});
+    }
+
+    game.hash = game.computeHash();
+    return game;
+}
+
+/* every player does a random legal action, placing bombs more often */
+static JointAction randomActions(const GameState& game, std::mt19937& rng) {
+    JointAction actions;
+    for (const auto& player : game.players) {
+        ActionMask mask = game.getActionMask(player.id);
+        ActionMask bombs = mask & 0x2aa;
+        if (bombs && rng() % 2)
+            mask = bombs;
+        for (int skip = rng() % __builtin_popcount(mask); skip; --skip)
+            mask &= mask - 1;
+        actions.set(player.id, GameState::decode(__builtin_ctz(mask), player.x, player.y));
+    }
+    return actions;
+}
+
+static void playRandomGame(const GameState& board, std::mt19937& rng, Coverage& coverage) {
+    GameState game = randomGame(board, rng);
+    auto explosions = game.getExplosions();
+    /* nobody is searched for, so succ lets any player die */
+    GameState::myid = -1;
+
+    for (int turn = 0; turn < 60 && !game.players.empty(); ++turn) {
+        auto succInfo = game.succ(explosions, randomActions(game, rng));
+        if (!CHECK(succInfo.has_value()))
+            return;
+        const auto& [next, extra] = succInfo.value();
+
+        if (!CHECK(next.hash == next.computeHash()))
+            return;
+        auto nextExplosions = next.getExplosions(game, explosions);
+        if (!CHECK(nextExplosions == next.getExplosions()))
+            return;
+
+        ++coverage.turns;
+        BitBoard bombCells;
+        bool stacked = false;
+        for (const auto& bomb : next.bombs) {
+            stacked |= bombCells.get(bomb.x, bomb.y);
+            bombCells.set(bomb.x, bomb.y);
+        }
+        coverage.stackedBombs += stacked;
+        bool dropped = false;
+        for (const auto& item : next.items)
+            dropped |= game.board.isBox(item.x, item.y);
+        bool picked = false;
+        for (int i = 0; i < GameState::MAX_PLAYERS; ++i)
+            picked |= extra.bombsIncrease[i] || extra.rangesIncrease[i];
+        coverage.droppedItems += dropped;
+        coverage.pickedItems += picked;
+        coverage.droppedAndPicked += dropped && picked;
+
+        game = next;
+        explosions = nextExplosions;
+    }
+}
+
+/* random games on the boards of the test cases, the incremental hash
+ * and explosions have to agree with the ones computed from scratch */
+static void testRandomGames() {
+    std::vector<GameState> boards;
+    for (const char* filename : {"tests/testcase1.txt", "tests/testcase2.txt"}) {
+        std::ifstream file(filename);
+        int width, height, id;
+        file >> width >> height >> id;
+        GameState board;
+        /* reading echoes the board */
+        auto buffer = std::cerr.rdbuf(nullptr);
+        file >> board;
+        std::cerr.rdbuf(buffer);
+        std::cerr.clear();
+        if (CHECK(bool(file)))
+            boards.push_back(board);
+    }
+    if (boards.empty())
+        return;
+
+    std::mt19937 rng(2137);
+    Coverage coverage;
+    int failed = failures;
+    for (int i = 0; i < 2000 && failures == failed; ++i)
+        playRandomGame(boards[i % boards.size()], rng, coverage);
+
+    /* the games have to go through the cases that the updates
+     * handle specially, otherwise they prove nothing */
+    CHECK(coverage.stackedBombs > 0);
+    CHECK(coverage.droppedItems > 0);
+    CHECK(coverage.pickedItems > 0);
+    CHECK(coverage.droppedAndPicked > 0);
+    std::cout << "  " << coverage.turns << " turns, "
+              << coverage.stackedBombs << " with stacked bombs, "
+              << coverage.droppedItems << " with dropped items, "
+              << coverage.pickedItems << " with picked items, "
+              << coverage.droppedAndPicked << " with both" << std::endl;
+}
+
+int main() {
+    const std::pair<void (*)(), const char*> tests[] = {
+        {testStackedBombs, "stacked bombs"},
+        {testRandomGames, "random games"},
+    };
+    for (const auto& [test, name] : tests) {
+        int failed = failures;
+        std::cout << name << std::endl;
+        test();
+        std::cout << (failures == failed ? "  ok" : "  FAILED") << std::endl;
+    }
+    return failures ? 1 : 0;
+}